@@ -31,8 +31,56 @@
 #define MSG_EXTENDED_INFO_POS       6
 
 #define MSG_NORMAL_FIELD_COUNT      6
-#define SEND_MSG_PROCESS_INTERVAL   200
+#define SEND_MSG_RETRY_INTERVAL     200
+#define SEND_MSG_TIMER_TICK         50
+#define SEND_MSG_TIMER_SLOTS        64
+// Retransmission timeout of msgs waiting for ack, adapted per peer.
+#define SEND_MSG_INITIAL_RTO        500
+#define SEND_MSG_MIN_RTO            100
+#define SEND_MSG_MAX_RTO            5000
 #define MAX_RE_SEND_TIMES           8
+// Received msgs remembered to drop their retransmits.
+#define RECENT_RECV_MSG_COUNT       1024
+// Msgs lost within this many msecs are reported in one notice.
+#define SEND_MSG_LOST_NOTICE_DELAY  1000
+
+// Peer list changes arriving within this many msecs are applied together.
+#define USER_UPDATE_FLUSH_INTERVAL  50
+
+// Cached peers not answering our BR_ENTRY in this many msecs are dropped.
+#define PRESENCE_CACHE_CONFIRM_TIMEOUT  5000
+#define PRESENCE_CACHE_MAX_AGE      (Q_INT64_C(7) * 24 * 3600 * 1000)
+#define PRESENCE_CACHE_MAX_PEERS    1024
+
+// ANSENTRY replies: jitter in msecs, dedup window in msecs, token bucket
+// rate per second and burst size.
+#define ANSENTRY_JITTER_PER_PEER    4
+#define ANSENTRY_MAX_JITTER         2000
+#define ANSENTRY_DEDUP_WINDOW       3000
+#define ANSENTRY_RATE               50
+#define ANSENTRY_BURST              20
+#define ANSENTRY_PRUNE_SIZE         256
+
+// Interface changes: re-announce delay, and poll interval where there is
+// no netlink.
+#define INTERFACE_ANNOUNCE_DELAY    1000
+#define INTERFACE_POLL_INTERVAL     10000
+
+// Multicast discovery, an administratively scoped IPv4 group.
+#define MULTICAST_DEFAULT_GROUP     "239.255.24.25"
+#define MULTICAST_TTL               8
+
+// ANSLIST pages of list server, in encoded bytes, and how long a peer table
+// snapshot serves follow-up pages, in msecs.
+#define HOSTLIST_PAGE_SIZE          8192
+#define HOSTLIST_SNAPSHOT_TTL       10000
+
+// Longest request line accepted on control socket.
+#define CONTROL_MAX_LINE_SIZE       (1024*1024)
+// A sendread msg waits this many msecs after ACK for READ, checked every
+// CONTROL_READ_EXPIRE_INTERVAL msecs.
+#define CONTROL_READ_TIMEOUT        (30*60*1000)
+#define CONTROL_READ_EXPIRE_INTERVAL (60*1000)
 
 #define COMMAND_SEPERATOR       ':'
 #define EXTEND_INFO_SEPERATOR   '\0'
@@ -0,0 +1,420 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "control_server.h"
+#include "global.h"
+#include "helper.h"
+#include "constants.h"
+#include "msg_thread.h"
+#include "user_manager.h"
+#include "send_file_manager.h"
+#include "file_server.h"
+#include "send_file_map.h"
+#include "send_msg.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QHostAddress>
+
+ControlServer::ControlServer(QObject *parent)
+    : QObject(parent), m_server(new QLocalServer(this))
+{
+    connect(m_server, SIGNAL(newConnection()),
+            this, SLOT(newConnection()));
+    connect(Global::msgThread, SIGNAL(newMsg(Msg)),
+            this, SLOT(newMsg(Msg)));
+    connect(Global::msgThread, SIGNAL(sendMsgAcked(Msg)),
+            this, SLOT(sendMsgAcked(Msg)));
+    connect(Global::msgThread, SIGNAL(sendMsgLost(Msg)),
+            this, SLOT(sendMsgLost(Msg)));
+    connect(Global::msgThread, SIGNAL(sendMsgReaded(Msg)),
+            this, SLOT(sendMsgReaded(Msg)));
+
+    m_clock.start();
+    m_expireTimer.setInterval(CONTROL_READ_EXPIRE_INTERVAL);
+    connect(&m_expireTimer, SIGNAL(timeout()),
+            this, SLOT(expirePendingMsgs()));
+}
+
+ControlServer::~ControlServer()
+{
+    m_server->close();
+}
+
+bool ControlServer::listen()
+{
+    // Only the user owning the instance may control it.
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+
+    // We hold the instance lock, so a socket left here is stale.
+    QLocalServer::removeServer(Helper::controlSocketPath());
+    if (!m_server->listen(Helper::controlSocketPath())) {
+        m_errorString = m_server->errorString();
+        qWarning("ControlServer::listen: %s: %s",
+                 Helper::controlSocketPath().toUtf8().data(),
+                 m_errorString.toUtf8().data());
+        return false;
+    }
+
+    return true;
+}
+
+void ControlServer::newConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
+        m_clients << socket;
+    }
+}
+
+void ControlServer::disconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket) {
+        m_clients.removeOne(socket);
+        m_watchers.removeOne(socket);
+
+        // Receipts of its msgs have nobody to go to.
+        QHash<qint64, PendingMsg>::iterator it = m_pendingMsgs.begin();
+        while (it != m_pendingMsgs.end()) {
+            if (!it->socket || it->socket == socket) {
+                it = m_pendingMsgs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        socket->deleteLater();
+    }
+}
+
+void ControlServer::readRequest()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket) {
+        return;
+    }
+
+    while (socket->canReadLine()) {
+        // Only the line end is stripped, blanks belong to TEXT and FILE.
+        QByteArray data = socket->readLine();
+        data.chop(1);
+        if (data.endsWith('\r')) {
+            data.chop(1);
+        }
+        if (data.isEmpty()) {
+            continue;
+        }
+        QString line = QString::fromUtf8(data);
+        handleRequest(socket, line.split(QChar('\t')));
+    }
+
+    if (socket->bytesAvailable() > CONTROL_MAX_LINE_SIZE) {
+        reply(socket, "ERR line too long");
+        socket->disconnectFromServer();
+    }
+}
+
+void ControlServer::handleRequest(QLocalSocket *socket,
+                                  const QStringList &fields)
+{
+    const QString &command = fields.at(0);
+
+    if (command == "status") {
+        reply(socket, QString("peers\t%1")
+              .arg(Global::userManager->peerCount()));
+        reply(socket, QString("transfers\t%1")
+              .arg(Global::sendFileManager->transferCount()));
+        reply(socket, QString("sendqueue\t%1")
+              .arg(Global::fileServer->queueDepth()));
+        reply(socket, QString("sendworkers\t%1")
+              .arg(Global::fileServer->activeWorkerCount()));
+        reply(socket, QString("sendevents\t%1")
+              .arg(Global::fileServer->eventConnectionCount()));
+        reply(socket, "OK");
+    } else if (command == "users") {
+        foreach (const Owner &owner, Global::userManager->onlinePeers()) {
+            QStringList fields;
+            fields << owner.ip() << owner.name() << owner.group()
+                << owner.host();
+            reply(socket, fields.join(QChar('\t')));
+        }
+        reply(socket, "OK");
+    } else if (command == "send" || command == "sendread") {
+        handleSend(socket, fields, command == "sendread");
+    } else if (command == "watch") {
+        if (!m_watchers.contains(socket)) {
+            m_watchers << socket;
+        }
+        reply(socket, "OK");
+    } else if (command == "quit") {
+        reply(socket, "OK");
+        socket->flush();
+        QCoreApplication::quit();
+    } else {
+        reply(socket, "ERR unknown command " + command);
+    }
+}
+
+// Msgs go straight to MsgThread, attachments to SendFileManager, as
+// ChatWindow::sendMessage() does.
+void ControlServer::handleSend(QLocalSocket *socket,
+                               const QStringList &fields, bool isReadCheck)
+{
+    if (fields.size() < 3) {
+        reply(socket, "ERR usage: send\tIPS\tTEXT[\tFILE...]");
+        return;
+    }
+
+    QList<Owner> owners = recipients(fields.at(1));
+    if (owners.isEmpty()) {
+        reply(socket, "ERR no recipient");
+        return;
+    }
+
+    QStringList pathList = fields.mid(3);
+    foreach (const QString &path, pathList) {
+        // We do not know the working directory of client.
+        if (QFileInfo(path).isRelative()) {
+            reply(socket, "ERR not an absolute path " + path);
+            return;
+        }
+        if (!QFileInfo(path).exists()) {
+            reply(socket, "ERR no such file " + path);
+            return;
+        }
+    }
+
+    quint32 flags = IPMSG_SENDMSG | IPMSG_SENDCHECKOPT;
+    if (isReadCheck) {
+        flags |= IPMSG_SECRETOPT | IPMSG_READCHECKOPT;
+    }
+    if (owners.size() > 1) {
+        flags |= IPMSG_MULTICASTOPT;
+    }
+    if (!pathList.isEmpty()) {
+        flags |= IPMSG_FILEATTACHOPT;
+    }
+
+    QString text = unescape(fields.at(2));
+
+    // Stat the files once, the transfers of all recipients share them.
+    SendFileSet sendFileSet(pathList);
+
+    foreach (const Owner &owner, owners) {
+        QString additionalInfo = text;
+        additionalInfo.append(QChar('\0'));
+
+        SendFileMap *sendFileMap = 0;
+        if (!pathList.isEmpty()) {
+            // SendFileManager owns it.
+            sendFileMap = new SendFileMap(sendFileSet);
+            additionalInfo.append(sendFileSet.packetString());
+            additionalInfo.append(QChar('\0'));
+        }
+
+        SendMsg sendMsg(owner.ipAddress(), IPMSG_DEFAULT_PORT,
+                        additionalInfo, ""/* extendedInfo */, flags);
+
+        if (sendFileMap) {
+            sendFileMap->setRecvUser(owner.name());
+            sendFileMap->setRecvHostname(owner.host());
+            sendFileMap->setPacketNo(sendMsg.packetNo());
+            Global::sendFileManager->addTransferLocked(
+                    sendFileMap->packetNo(), sendFileMap);
+        }
+
+        PendingMsg pending;
+        pending.socket = socket;
+        pending.ip = owner.ip();
+        pending.readDeadline = 0;
+        m_pendingMsgs.insert(sendMsg.packetNo(), pending);
+        reply(socket, QString("QUEUED\t%1\t%2")
+              .arg(sendMsg.packetNo()).arg(owner.ip()));
+
+        Global::msgThread->addSendMsg(Msg(sendMsg));
+    }
+
+    reply(socket, "OK");
+}
+
+QList<Owner> ControlServer::recipients(const QString &ips) const
+{
+    QList<Owner> online = Global::userManager->onlinePeers();
+    if (ips == "*") {
+        return online;
+    }
+
+    QHash<QString, Owner> byIp;
+    foreach (const Owner &owner, online) {
+        byIp.insert(owner.ip(), owner);
+    }
+
+    // Unknown hosts get a msg too, they just have no name yet.
+    QList<Owner> owners;
+    foreach (const QString &ip, ips.split(QChar(','), QString::SkipEmptyParts)) {
+        QHostAddress address(ip.trimmed());
+        if (address.isNull()) {
+            continue;
+        }
+
+        Owner owner = byIp.value(address.toString());
+        if (owner.ipAddress().isNull()) {
+            owner.setIpAddress(address);
+            owner.setName(address.toString());
+        }
+        owners << owner;
+    }
+
+    return owners;
+}
+
+void ControlServer::reply(QLocalSocket *socket, const QString &line)
+{
+    socket->write(line.toUtf8() + '\n');
+}
+
+// Tell the client which sent 'packetNo', forget it when 'isDone'.
+void ControlServer::notify(qint64 packetNo, const QString &event,
+                           bool isDone)
+{
+    QHash<qint64, PendingMsg>::iterator it = m_pendingMsgs.find(packetNo);
+    if (it == m_pendingMsgs.end()) {
+        return;
+    }
+
+    if (it->socket) {
+        reply(it->socket, event);
+    }
+
+    if (isDone || !it->socket) {
+        m_pendingMsgs.erase(it);
+    }
+}
+
+void ControlServer::sendMsgAcked(const Msg &msg)
+{
+    bool isReadCheck = GET_OPT(msg->flags()) & IPMSG_READCHECKOPT;
+    notify(msg->packetNo(), QString("ACK\t%1\t%2")
+           .arg(msg->packetNo()).arg(msg->ip()), !isReadCheck);
+
+    // READ may never come, the reader may just not open it.
+    QHash<qint64, PendingMsg>::iterator it
+        = m_pendingMsgs.find(msg->packetNo());
+    if (it != m_pendingMsgs.end()) {
+        it->readDeadline = m_clock.elapsed() + CONTROL_READ_TIMEOUT;
+        if (!m_expireTimer.isActive()) {
+            m_expireTimer.start();
+        }
+    }
+}
+
+void ControlServer::expirePendingMsgs()
+{
+    qint64 now = m_clock.elapsed();
+    bool hasDeadline = false;
+
+    QHash<qint64, PendingMsg>::iterator it = m_pendingMsgs.begin();
+    while (it != m_pendingMsgs.end()) {
+        if (it->readDeadline == 0) {
+            ++it;
+        } else if (it->readDeadline <= now) {
+            if (it->socket) {
+                reply(it->socket, QString("NOREAD\t%1\t%2")
+                      .arg(it.key()).arg(it->ip));
+            }
+            it = m_pendingMsgs.erase(it);
+        } else {
+            hasDeadline = true;
+            ++it;
+        }
+    }
+
+    if (!hasDeadline) {
+        m_expireTimer.stop();
+    }
+}
+
+void ControlServer::sendMsgLost(const Msg &msg)
+{
+    notify(msg->packetNo(), QString("LOST\t%1\t%2")
+           .arg(msg->packetNo()).arg(msg->ip()), true);
+}
+
+void ControlServer::sendMsgReaded(const Msg &msg)
+{
+    bool ok;
+    qint64 packetNo = msg->additionalInfo().trimmed().toLongLong(&ok);
+    if (ok) {
+        notify(packetNo, QString("READ\t%1\t%2")
+               .arg(packetNo).arg(msg->ip()), true);
+    }
+}
+
+void ControlServer::newMsg(const Msg &msg)
+{
+    if (GET_MODE(msg->flags()) != IPMSG_SENDMSG) {
+        return;
+    }
+
+    // Without a window to show them, received msgs are logged.
+    if (!Global::windowManager) {
+        qDebug("ControlServer::newMsg: from %s: %s",
+               msg->ip().toUtf8().data(),
+               msg->additionalInfo().toUtf8().data());
+    }
+
+    QString event = QString("MSG\t%1\t%2").arg(msg->ip())
+        .arg(escape(msg->additionalInfo()));
+    foreach (QLocalSocket *socket, m_watchers) {
+        reply(socket, event);
+    }
+}
+
+QString ControlServer::unescape(const QString &text)
+{
+    QString s;
+    s.reserve(text.size());
+
+    for (int i = 0; i < text.size(); ++i) {
+        if (text.at(i) == '\\' && i + 1 < text.size()) {
+            QChar c = text.at(++i);
+            if (c == 'n') {
+                s += '\n';
+            } else if (c == 't') {
+                s += '\t';
+            } else {
+                s += c;
+            }
+        } else {
+            s += text.at(i);
+        }
+    }
+
+    return s;
+}
+
+QString ControlServer::escape(const QString &text)
+{
+    QString s = text;
+    s.replace('\\', "\\\\");
+    s.replace('\n', "\\n");
+    s.replace('\t', "\\t");
+    return s;
+}
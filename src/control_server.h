@@ -0,0 +1,106 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include "msg.h"
+#include "owner.h"
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Local control socket, Helper::controlSocketPath(), for scripts and for
+// the headless qipmsgd. Requests are lines of tab separated fields, each
+// answered by zero or more data lines and a final "OK" or "ERR <reason>"
+// line. Requests may be pipelined, every complete line read is handled
+// at once, so a script can queue thousands of msgs per round trip.
+//
+//   status             peer and pending transfer counts, queued send
+//                      connections, busy send workers and event loop
+//                      connections
+//   users              one "ip\tname\tgroup\thost" line per online peer
+//   send\tIPS\tTEXT[\tFILE...]
+//   sendread\tIPS\tTEXT[\tFILE...]
+//                      send TEXT with FILEs attached to comma separated
+//                      IPS, "*" for all online peers; answered by one
+//                      "QUEUED\tpacketno\tip" line per recipient, then
+//                      "ACK", "LOST" and for sendread "READ" event lines
+//                      with the same packetno and ip follow, "NOREAD"
+//                      if no READ comes within CONTROL_READ_TIMEOUT
+//                      after ACK
+//   watch              receive "MSG\tip\tTEXT" event lines for msgs
+//   quit               stop the instance
+//
+// In TEXT "\n", "\t" and "\\" stand for newline, tab and backslash. FILE
+// paths must be absolute.
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ControlServer(QObject *parent = 0);
+    ~ControlServer();
+
+    bool listen();
+    QString errorString() const { return m_errorString; }
+
+private slots:
+    void newConnection();
+    void readRequest();
+    void disconnected();
+    void newMsg(const Msg &msg);
+    void sendMsgAcked(const Msg &msg);
+    void sendMsgLost(const Msg &msg);
+    void sendMsgReaded(const Msg &msg);
+    void expirePendingMsgs();
+
+private:
+    void handleRequest(QLocalSocket *socket, const QStringList &fields);
+    void handleSend(QLocalSocket *socket, const QStringList &fields,
+                    bool isReadCheck);
+    QList<Owner> recipients(const QString &ips) const;
+    void reply(QLocalSocket *socket, const QString &line);
+    void notify(qint64 packetNo, const QString &event, bool isDone);
+
+    static QString unescape(const QString &text);
+    static QString escape(const QString &text);
+
+    QLocalServer *m_server;
+    QList<QLocalSocket *> m_clients;
+    QList<QLocalSocket *> m_watchers;
+    // Msgs waiting for receipts, by packet no.
+    struct PendingMsg {
+        QPointer<QLocalSocket> socket;  // client which sent it
+        QString ip;
+        qint64 readDeadline;            // in m_clock time, 0 until ACK
+    };
+    QHash<qint64, PendingMsg> m_pendingMsgs;
+    QTimer m_expireTimer;
+    QElapsedTimer m_clock;
+    QString m_errorString;
+};
+
+#endif // !CONTROL_SERVER_H
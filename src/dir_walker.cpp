@@ -0,0 +1,164 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "dir_walker.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+DirWalker::DirWalker(const QString &rootPath)
+    : m_rootPath(rootPath), m_isStarted(false), m_size(0), m_mtime(0),
+    m_ctime(0), m_fileDirFd(-1)
+{
+}
+
+DirWalker::~DirWalker()
+{
+    foreach (Level level, m_stack) {
+        if (level.dir) {
+            closedir(level.dir);
+        }
+    }
+}
+
+DirWalker::EntryTypes DirWalker::next()
+{
+    if (!m_isStarted) {
+        m_isStarted = true;
+
+        QByteArray path = QFile::encodeName(m_rootPath);
+        struct stat st;
+        if (stat(path.constData(), &st) == -1 || !S_ISDIR(st.st_mode)) {
+            m_errorString = "DirWalker::next: stat root error";
+            return Error;
+        }
+        DIR *dir = opendir(path.constData());
+        if (!dir) {
+            m_errorString = strerror(errno);
+            return Error;
+        }
+
+        QByteArray name = QFile::encodeName(QFileInfo(m_rootPath).fileName());
+        // If send directory is root directory, we change its name to
+        // "(root-directory)"
+        if (name.isEmpty() || name == "/") {
+            name = "(root-directory)";
+        }
+
+        return enterDir(dir, name, st);
+    }
+
+    while (!m_stack.isEmpty()) {
+        Level &level = m_stack.last();
+
+        struct dirent *entry = 0;
+        if (level.dir) {
+            entry = readdir(level.dir);
+        }
+
+        if (!entry) {
+            if (level.dir) {
+                closedir(level.dir);
+            }
+            m_name = ".";
+            m_size = 0;
+            m_mtime = level.mtime;
+            m_ctime = level.ctime;
+            m_stack.removeLast();
+            return LeaveDir;
+        }
+
+        // Skip '.', '..' and hidden entries, like the QDir walk did.
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        int fd = dirfd(level.dir);
+        struct stat st;
+        if (fstatat(fd, entry->d_name, &st, 0) == -1) {
+            continue;
+        }
+
+        if (S_ISREG(st.st_mode)) {
+            m_name = entry->d_name;
+            m_size = st.st_size;
+            m_mtime = st.st_mtime;
+            m_ctime = st.st_ctime;
+            m_fileDirFd = fd;
+            return RegularFile;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            // A directory we can not read fails the transfer, rather than
+            // being sended as empty.
+            DIR *dir = 0;
+            int dfd = openat(fd, entry->d_name,
+                             O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dfd != -1) {
+                dir = fdopendir(dfd);
+            }
+            if (!dir) {
+                m_errorString = QString("%1: %2")
+                    .arg(QFile::decodeName(entry->d_name))
+                    .arg(strerror(errno));
+                if (dfd != -1) {
+                    close(dfd);
+                }
+                return Error;
+            }
+            return enterDir(dir, QByteArray(entry->d_name), st);
+        }
+    }
+
+    return End;
+}
+
+DirWalker::EntryTypes DirWalker::enterDir(DIR *dir, const QByteArray &name,
+                                          const struct stat &st)
+{
+    Level level;
+    level.dir = dir;
+    level.mtime = st.st_mtime;
+    level.ctime = st.st_ctime;
+    m_stack.append(level);
+
+    m_name = name;
+    m_size = 0;
+    m_mtime = st.st_mtime;
+    m_ctime = st.st_ctime;
+    m_fileDirFd = -1;
+
+    return EnterDir;
+}
+
+int DirWalker::openFile()
+{
+    if (m_fileDirFd == -1) {
+        return -1;
+    }
+
+    int fd = openat(m_fileDirFd, m_name.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        m_errorString = strerror(errno);
+    }
+
+    return fd;
+}
@@ -0,0 +1,76 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef DIR_WALKER_H
+#define DIR_WALKER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+#include <sys/types.h>
+#include <dirent.h>
+
+// Iterative, streaming walk of a directory tree for directory transfer.
+// Entries are read with readdir() and stated once with fstatat() relative
+// to the open parent directory, only one DIR per directory level is kept,
+// so memory is bounded by tree depth, not tree size. Hidden entries are
+// skipped, and a subdirectory that can not be opened is an Error.
+class DirWalker
+{
+public:
+    enum EntryTypes { EnterDir, RegularFile, LeaveDir, End, Error };
+
+    DirWalker(const QString &rootPath);
+    ~DirWalker();
+
+    EntryTypes next();
+
+    // Current entry, valid until next call of next(). name() is in local
+    // 8 bit encoding, and is "." for LeaveDir.
+    const QByteArray &name() const { return m_name; }
+    qint64 size() const { return m_size; }
+    time_t lastModified() const { return m_mtime; }
+    time_t created() const { return m_ctime; }
+
+    // Open current regular file for reading, return -1 on error.
+    int openFile();
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    struct Level {
+        DIR *dir;
+        time_t mtime;
+        time_t ctime;
+    };
+
+    EntryTypes enterDir(DIR *dir, const QByteArray &name,
+                        const struct stat &st);
+
+    QString m_rootPath;
+    bool m_isStarted;
+    QList<Level> m_stack;
+
+    QByteArray m_name;
+    qint64 m_size;
+    time_t m_mtime;
+    time_t m_ctime;
+    int m_fileDirFd;
+
+    QString m_errorString;
+};
+
+#endif // !DIR_WALKER_H
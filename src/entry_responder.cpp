@@ -0,0 +1,126 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "entry_responder.h"
+#include "constants.h"
+
+#include <QDateTime>
+
+#include <unistd.h>
+
+EntryResponder::EntryResponder(QObject *parent)
+    : QObject(parent),
+    m_timerWheel(SEND_MSG_TIMER_TICK, SEND_MSG_TIMER_SLOTS),
+    m_tokens(ANSENTRY_BURST), m_lastRefill(0),
+    m_sentCount(0), m_suppressedCount(0)
+{
+    connect(&m_timerWheel, SIGNAL(expired()),
+            this, SLOT(processExpired()));
+
+    // XXX NOTE: qrand() is seeded per thread, an unseeded msg thread
+    // would give every host on the LAN the same jitter.
+    qsrand(uint(QDateTime::currentMSecsSinceEpoch()) ^ uint(getpid()));
+
+    m_clock.start();
+}
+
+void EntryResponder::respond(const QHostAddress &address, quint16 port,
+                             int peerCount)
+{
+    quint32 key = address.toIPv4Address();
+    qint64 now = m_clock.elapsed();
+
+    if (m_pending.contains(key)) {
+        ++m_suppressedCount;
+        return;
+    }
+
+    QHash<quint32, qint64>::const_iterator it = m_replied.constFind(key);
+    if (it != m_replied.constEnd() && now - it.value() < ANSENTRY_DEDUP_WINDOW) {
+        ++m_suppressedCount;
+        qDebug("EntryResponder::respond: suppress duplicate entry from %s",
+               address.toString().toUtf8().data());
+        return;
+    }
+
+    Pending pending;
+    pending.address = address;
+    pending.port = port;
+    m_pending.insert(key, pending);
+
+    int maxJitter = qMin(ANSENTRY_MAX_JITTER,
+                         peerCount * ANSENTRY_JITTER_PER_PEER);
+    m_timerWheel.schedule(key, maxJitter > 0 ? qrand() % maxJitter : 0);
+}
+
+void EntryResponder::processExpired()
+{
+    qint64 now = m_clock.elapsed();
+
+    foreach (qint64 key, m_timerWheel.takeExpired()) {
+        QHash<quint32, Pending>::iterator it = m_pending.find(quint32(key));
+        if (it == m_pending.end()) {
+            continue;
+        }
+
+        // Out of tokens, try again when the next one is due.
+        if (!takeToken()) {
+            m_timerWheel.schedule(key, 1000 / ANSENTRY_RATE);
+            continue;
+        }
+
+        Pending pending = it.value();
+        m_pending.erase(it);
+        m_replied.insert(quint32(key), now);
+        ++m_sentCount;
+
+        emit sendAnsEntry(pending.address, pending.port);
+    }
+
+    pruneReplied(now);
+}
+
+bool EntryResponder::takeToken()
+{
+    qint64 now = m_clock.elapsed();
+
+    m_tokens = qMin(double(ANSENTRY_BURST),
+                    m_tokens + (now - m_lastRefill) * ANSENTRY_RATE / 1000.0);
+    m_lastRefill = now;
+
+    if (m_tokens < 1.0) {
+        return false;
+    }
+
+    m_tokens -= 1.0;
+    return true;
+}
+
+void EntryResponder::pruneReplied(qint64 now)
+{
+    if (m_replied.size() < ANSENTRY_PRUNE_SIZE) {
+        return;
+    }
+
+    QHash<quint32, qint64>::iterator it = m_replied.begin();
+    while (it != m_replied.end()) {
+        if (now - it.value() >= ANSENTRY_DEDUP_WINDOW) {
+            it = m_replied.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ENTRY_RESPONDER_H
+#define ENTRY_RESPONDER_H
+
+#include "timer_wheel.h"
+
+#include <QObject>
+#include <QHash>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+// Schedules ANSENTRY replies to BR_ENTRY. Replies are delayed by a random
+// jitter growing with the number of known peers, repeated BR_ENTRY from
+// the same host are answered once per ANSENTRY_DEDUP_WINDOW, and a token
+// bucket bounds the reply rate, so a subnet booting together does not
+// flood the switches. Only used in msg thread.
+class EntryResponder : public QObject
+{
+    Q_OBJECT
+
+public:
+    EntryResponder(QObject *parent = 0);
+
+    void respond(const QHostAddress &address, quint16 port, int peerCount);
+
+    quint64 sentCount() const { return m_sentCount; }
+    quint64 suppressedCount() const { return m_suppressedCount; }
+
+signals:
+    // Time to send ANSENTRY to 'address'.
+    void sendAnsEntry(const QHostAddress &address, quint16 port);
+
+private slots:
+    void processExpired();
+
+private:
+    bool takeToken();
+    void pruneReplied(qint64 now);
+
+    struct Pending {
+        QHostAddress address;
+        quint16 port;
+    };
+
+    TimerWheel m_timerWheel;
+    // Replies waiting for their jitter, key is IPv4 address.
+    QHash<quint32, Pending> m_pending;
+    // Time of last reply to each host.
+    QHash<quint32, qint64> m_replied;
+
+    QElapsedTimer m_clock;
+    double m_tokens;
+    qint64 m_lastRefill;
+
+    quint64 m_sentCount;
+    quint64 m_suppressedCount;
+};
+
+#endif // !ENTRY_RESPONDER_H
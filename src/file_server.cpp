@@ -14,35 +14,74 @@
 // along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
 //
 
-#include "send_file_thread.h"
 #include "file_server.h"
+#include "send_file_event_loop.h"
 #include "constants.h"
 #include "global.h"
-#include "send_file_model.h"
 #include "send_file_manager.h"
+#include "preferences.h"
+
+#include <signal.h>
 
-#include <QMessageBox>
-#include <QApplication>
 
 FileServer::FileServer(QObject *parent)
     : QTcpServer(parent)
 {
+    // XXX NOTE: sendfile() can not take MSG_NOSIGNAL, a peer resetting the
+    // connection must fail the send with EPIPE instead of killing us.
+    signal(SIGPIPE, SIG_IGN);
+
+    m_pool.setMaxThreadCount(Global::preferences->maxSendFileThreadCount);
+
+    if (Global::preferences->isEventDrivenFileServer) {
+        startEventLoops(Global::preferences->fileServerEventLoopCount);
+    }
+
     startListening();
 }
 
 FileServer::~FileServer()
 {
+    foreach (SendFileEventLoop *loop, m_eventLoops) {
+        delete loop;
+    }
+}
+
+// XXX NOTE: Qt5 pass descriptor as qintptr, a 'int' version never be called.
+void FileServer::incomingConnection(qintptr socketDescriptor)
+{
+    if (m_eventLoops.isEmpty()) {
+        m_pool.addConnection(socketDescriptor);
+        return;
+    }
+
+    // Give it to the loop serving fewest connections.
+    SendFileEventLoop *loop = m_eventLoops.first();
+    foreach (SendFileEventLoop *l, m_eventLoops) {
+        if (l->connectionCount() < loop->connectionCount()) {
+            loop = l;
+        }
+    }
+    loop->addConnection(socketDescriptor);
 }
 
-void FileServer::incomingConnection(int socketDescriptor)
+void FileServer::startEventLoops(int count)
 {
-    SendFileThread *sendFileThread
-        = new SendFileThread(socketDescriptor, this);
+    for (int i = 0; i < qMax(count, 1); ++i) {
+        SendFileEventLoop *loop = new SendFileEventLoop;
+        m_eventLoops << loop;
+        loop->start();
+    }
+}
 
-    connect(sendFileThread, SIGNAL(finished()),
-            sendFileThread, SLOT(deleteLater()));
+int FileServer::eventConnectionCount() const
+{
+    int count = 0;
+    foreach (SendFileEventLoop *loop, m_eventLoops) {
+        count += loop->connectionCount();
+    }
 
-    sendFileThread->start();
+    return count;
 }
 
 void FileServer::startListening()
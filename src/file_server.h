@@ -17,7 +17,12 @@
 #ifndef FILE_SERVER_H
 #define FILE_SERVER_H
 
+#include "send_file_thread_pool.h"
+
 #include <QTcpServer>
+#include <QList>
+
+class SendFileEventLoop;
 
 class FileServer : public QTcpServer
 {
@@ -27,13 +32,25 @@ public:
     FileServer(QObject *parent = 0);
     ~FileServer();
 
+    void setMaxThreadCount(int count) { m_pool.setMaxThreadCount(count); }
+
+    int queueDepth() const { return m_pool.queueDepth(); }
+    int activeWorkerCount() const { return m_pool.activeWorkerCount(); }
+
+    // Connections served by epoll loops, when event driven mode is on.
+    int eventConnectionCount() const;
+
 private slots:
 
 protected:
-    void incomingConnection(int socketDescriptor);
+    void incomingConnection(qintptr socketDescriptor);
 
 private:
     void startListening();
+    void startEventLoops(int count);
+
+    SendFileThreadPool m_pool;
+    QList<SendFileEventLoop *> m_eventLoops;
 };
 
 #endif // !FILE_SERVER_H
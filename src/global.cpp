@@ -15,9 +15,12 @@
 //
 
 #include <QSettings>
+#include <QObject>
+#ifndef QIPMSG_DAEMON
 #include <QIcon>
 #include <QtGui>
 #include <QtWidgets/QtWidgets>
+#endif
 
 #include "global.h"
 #include "helper.h"
@@ -25,12 +28,14 @@
 #include "user_manager.h"
 #include "msg_thread.h"
 #include "transfer_codec.h"
-#include "systray.h"
-#include "window_manager.h"
 #include "file_server.h"
 #include "constants.h"
 #include "send_file_manager.h"
+#ifndef QIPMSG_DAEMON
+#include "systray.h"
+#include "window_manager.h"
 #include "sound_thread.h"
+#endif
 
 SendFileManager *Global::sendFileManager = 0;
 QSettings *Global::settings = 0;
@@ -44,15 +49,21 @@ FileServer *Global::fileServer = 0;
 MsgThread *Global::msgThread = 0;
 SoundThread *Global::soundThread = 0;
 
+#ifndef QIPMSG_DAEMON
 static void createIconSet();
+#endif
 
 using namespace Global;
 
+// XXX NOTE: with QIPMSG_DAEMON, for qipmsgd, no gui object is created and
+// windowManager, systray, soundThread and iconSet stay empty.
 void Global::globalInit(QString path)
 {
     qDebug("Global::globalInit");
 
+#ifndef QIPMSG_DAEMON
     createIconSet();
+#endif
 
     Helper::setIniPath(path);
 
@@ -73,12 +84,15 @@ void Global::globalInit(QString path)
     fileServer = new FileServer;
 
     msgThread = new MsgThread;
-    soundThread = new SoundThread;
 
     userManager = new UserManager;
+
+#ifndef QIPMSG_DAEMON
+    soundThread = new SoundThread;
     windowManager = new WindowManager;
 
     systray = new Systray;
+#endif
 }
 
 void Global::globalEnd()
@@ -89,12 +103,17 @@ void Global::globalEnd()
 
     delete userManager;
 
+#ifndef QIPMSG_DAEMON
     delete windowManager;
+#endif
 
     delete msgThread;
+
+#ifndef QIPMSG_DAEMON
     delete soundThread;
 
     delete systray;
+#endif
 
     delete fileServer;
 
@@ -106,12 +125,14 @@ void Global::globalEnd()
     delete settings;
 }
 
+#ifndef QIPMSG_DAEMON
 static void createIconSet()
 {
     iconSet.insert("normal", new QIcon(QString(":/icons/") + "qipmsg.xpm"));
     iconSet.insert("receive",
                    new QIcon(QString(":/icons/") + "qipmsg_recv.xpm"));
 }
+#endif // !QIPMSG_DAEMON
 
 QString Global::fileCountString(int i)
 {
@@ -125,6 +146,7 @@ QString Global::fileCountString(int i)
     return s;
 }
 
+#ifndef QIPMSG_DAEMON
 QPoint Global::randomNearMiddlePoint()
 {
     QRect rect(QApplication::desktop()->screenGeometry());
@@ -132,4 +154,5 @@ QPoint Global::randomNearMiddlePoint()
     int y = qrand() % (rect.height() / 6);
     return QPoint(rect.width()/6 + x, rect.height()/8 + y);
 }
+#endif // !QIPMSG_DAEMON
 
@@ -25,7 +25,7 @@
 
 QString Helper::m_iniPath;
 QString Helper::m_appPath;
-qint64 Helper::m_packetNo;
+QAtomicInteger<qint64> Helper::m_packetNo;
 QFile Helper::m_internalLogFile;
 QString Helper::m_internalLogFileName;
 
@@ -68,6 +68,11 @@ QString Helper::lockFile()
     return appHomePath() + "/qipmsg.lock";
 }
 
+QString Helper::controlSocketPath()
+{
+    return appHomePath() + "/qipmsg.sock";
+}
+
 QString Helper::iniPath()
 {
     if (!m_iniPath.isEmpty()) {
@@ -142,19 +147,17 @@ QString Helper::getEnvironmentVariable(QRegExp regExp)
 
 void Helper::setPacketNo(qint64 n)
 {
-    m_packetNo = n;
+    m_packetNo.store(n);
 }
 
 QString Helper::packetNoString()
 {
-    ++m_packetNo;
-    return QString("%1").arg(m_packetNo);
+    return QString::number(packetNo());
 }
 
 qint64 Helper::packetNo()
 {
-    ++m_packetNo;
-    return m_packetNo;
+    return m_packetNo.fetchAndAddOrdered(1) + 1;
 }
 
 void Helper::setInternalLogFileName(QString filePath)
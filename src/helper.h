@@ -19,6 +19,7 @@
 
 #include <QRegExp>
 #include <QFile>
+#include <QAtomicInteger>
 
 class Helper {
 public:
@@ -28,6 +29,7 @@ public:
     static QString appHomePath();
 
     static QString lockFile();
+    static QString controlSocketPath();
 
     static void setIniPath(QString path);
     static QString iniPath();
@@ -44,6 +46,7 @@ public:
     static QString getEnvironmentVariable(QRegExp regExp);
 
     static void setPacketNo(qint64 n);
+    // Next packet number, may be called in any thread.
     static QString packetNoString();
     static qint64 packetNo();
 
@@ -61,7 +64,7 @@ private:
 
     static QString m_appPath;
     static QString m_iniPath;
-    static qint64 m_packetNo;
+    static QAtomicInteger<qint64> m_packetNo;
     static QFile m_internalLogFile;
     static QString m_internalLogFileName;
 };
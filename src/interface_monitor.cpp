@@ -0,0 +1,253 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "interface_monitor.h"
+#include "constants.h"
+
+#include <QNetworkInterface>
+#include <QSet>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define NETLINK_BUFFER_SIZE         8192
+#endif
+
+InterfaceMonitor::InterfaceMonitor(QObject *parent)
+    : QObject(parent), m_announceTimer(new QTimer(this))
+#ifdef Q_OS_LINUX
+    , m_fd(-1), m_notifier(0)
+#else
+    , m_timer(0)
+#endif
+{
+    m_announceTimer->setSingleShot(true);
+    m_announceTimer->setInterval(INTERFACE_ANNOUNCE_DELAY);
+    connect(m_announceTimer, SIGNAL(timeout()), this, SIGNAL(interfaceUp()));
+}
+
+InterfaceMonitor::~InterfaceMonitor()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd != -1) {
+        close(m_fd);
+    }
+#endif
+}
+
+void InterfaceMonitor::start()
+{
+#ifdef Q_OS_LINUX
+    // Subscribe before enumerating, so no change falls in between.
+    m_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE);
+    if (m_fd != -1) {
+        struct sockaddr_nl addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+        if (bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+            qWarning("InterfaceMonitor::start: netlink bind: %s",
+                     strerror(errno));
+            close(m_fd);
+            m_fd = -1;
+        }
+    } else {
+        qWarning("InterfaceMonitor::start: netlink socket: %s",
+                 strerror(errno));
+    }
+
+    if (m_fd != -1) {
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, SIGNAL(activated(int)),
+                this, SLOT(processEvents()));
+    }
+#else
+    m_timer = new QTimer(this);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(processEvents()));
+    m_timer->start(INTERFACE_POLL_INTERVAL);
+#endif
+
+    QHash<QHostAddress, QHostAddress> addresses;
+    enumerate(addresses);
+    setAddresses(addresses);
+
+#ifdef Q_OS_LINUX
+    foreach (QNetworkInterface interface, QNetworkInterface::allInterfaces()) {
+        m_linkRunning.insert(interface.index(),
+            (interface.flags() & QNetworkInterface::IsUp)
+            && (interface.flags() & QNetworkInterface::IsRunning));
+    }
+#endif
+}
+
+void InterfaceMonitor::enumerate(
+        QHash<QHostAddress, QHostAddress> &addresses) const
+{
+    foreach (QNetworkInterface interface, QNetworkInterface::allInterfaces()) {
+        foreach (QNetworkAddressEntry entry, interface.addressEntries()) {
+            QHostAddress broadcastAddress = entry.broadcast();
+            if (broadcastAddress != QHostAddress::Null &&
+                entry.ip() != QHostAddress::LocalHost) {
+                addresses.insert(entry.ip(), broadcastAddress);
+            }
+        }
+    }
+}
+
+// Return true if any address is new.
+bool InterfaceMonitor::setAddresses(
+        const QHash<QHostAddress, QHostAddress> &addresses)
+{
+    if (addresses == m_addresses) {
+        return false;
+    }
+
+    bool isAdded = false;
+    QHash<QHostAddress, QHostAddress>::const_iterator it;
+    for (it = addresses.constBegin(); it != addresses.constEnd(); ++it) {
+        if (!m_addresses.contains(it.key())) {
+            isAdded = true;
+            break;
+        }
+    }
+
+    m_addresses = addresses;
+    rebuildBroadcastAddresses();
+
+    emit changed();
+    return isAdded;
+}
+
+void InterfaceMonitor::rebuildBroadcastAddresses()
+{
+    // NOTE: Just to remove duplicate entries.
+    QSet<QHostAddress> set;
+    foreach (const QHostAddress &address, m_addresses) {
+        set.insert(address);
+    }
+    m_broadcastAddresses = set.toList();
+}
+
+#ifdef Q_OS_LINUX
+
+void InterfaceMonitor::processEvents()
+{
+    QHash<QHostAddress, QHostAddress> addresses = m_addresses;
+    bool isLinkUp = false;
+
+    char buf[NETLINK_BUFFER_SIZE]
+        __attribute__((aligned(__alignof__(struct nlmsghdr))));
+    for (;;) {
+        ssize_t len = recv(m_fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // Events were dropped, start over from a full walk.
+                qWarning("InterfaceMonitor::processEvents: netlink overrun");
+                addresses.clear();
+                enumerate(addresses);
+                continue;
+            }
+            break;
+        }
+        if (len == 0) {
+            break;
+        }
+
+        for (struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+             NLMSG_OK(nh, (size_t)len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == RTM_NEWLINK
+                    || nh->nlmsg_type == RTM_DELLINK) {
+                struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nh);
+                bool isRunning = nh->nlmsg_type == RTM_NEWLINK
+                    && (ifi->ifi_flags & IFF_UP)
+                    && (ifi->ifi_flags & IFF_RUNNING);
+                if (isRunning && !m_linkRunning.value(ifi->ifi_index)) {
+                    isLinkUp = true;
+                }
+                m_linkRunning.insert(ifi->ifi_index, isRunning);
+                continue;
+            }
+
+            if (nh->nlmsg_type != RTM_NEWADDR
+                    && nh->nlmsg_type != RTM_DELADDR) {
+                continue;
+            }
+
+            struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nh);
+            if (ifa->ifa_family != AF_INET) {
+                continue;
+            }
+
+            QHostAddress local;
+            QHostAddress broadcast;
+            int attrLen = IFA_PAYLOAD(nh);
+            for (struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, attrLen);
+                 rta = RTA_NEXT(rta, attrLen)) {
+                quint32 ip = ntohl(*(quint32 *)RTA_DATA(rta));
+                if (rta->rta_type == IFA_LOCAL) {
+                    local.setAddress(ip);
+                } else if (rta->rta_type == IFA_ADDRESS && local.isNull()) {
+                    local.setAddress(ip);
+                } else if (rta->rta_type == IFA_BROADCAST) {
+                    broadcast.setAddress(ip);
+                }
+            }
+
+            if (local.isNull() || local == QHostAddress::LocalHost) {
+                continue;
+            }
+
+            if (nh->nlmsg_type == RTM_DELADDR) {
+                addresses.remove(local);
+            } else if (!broadcast.isNull()) {
+                addresses.insert(local, broadcast);
+            }
+        }
+    }
+
+    if (setAddresses(addresses) || isLinkUp) {
+        m_announceTimer->start();
+    }
+}
+
+#else // !Q_OS_LINUX
+
+void InterfaceMonitor::processEvents()
+{
+    QHash<QHostAddress, QHostAddress> addresses;
+    enumerate(addresses);
+
+    if (setAddresses(addresses)) {
+        m_announceTimer->start();
+    }
+}
+
+#endif // Q_OS_LINUX
@@ -0,0 +1,83 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef INTERFACE_MONITOR_H
+#define INTERFACE_MONITOR_H
+
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QHostAddress>
+
+class QTimer;
+#ifdef Q_OS_LINUX
+class QSocketNotifier;
+#endif
+
+// IPv4 addresses of local interfaces and their broadcast addresses, kept
+// up to date incrementally. Interfaces are enumerated once at start, then
+// on Linux rtnetlink address and link events are applied as they come.
+// Other platforms re-enumerate every INTERFACE_POLL_INTERVAL msecs.
+class InterfaceMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    InterfaceMonitor(QObject *parent = 0);
+    ~InterfaceMonitor();
+
+    void start();
+
+    // Deduplicated, no enumeration is done here.
+    const QList<QHostAddress> &broadcastAddresses() const {
+        return m_broadcastAddresses;
+    }
+    QList<QHostAddress> ipAddresses() const { return m_addresses.keys(); }
+    // Local ip to broadcast address.
+    const QHash<QHostAddress, QHostAddress> &addresses() const {
+        return m_addresses;
+    }
+
+signals:
+    // Broadcast addresses changed.
+    void changed();
+    // An address was added or a link came up, peers should be told again.
+    // Bursts of events within INTERFACE_ANNOUNCE_DELAY give one signal.
+    void interfaceUp();
+
+private slots:
+    void processEvents();
+
+private:
+    void enumerate(QHash<QHostAddress, QHostAddress> &addresses) const;
+    bool setAddresses(const QHash<QHostAddress, QHostAddress> &addresses);
+    void rebuildBroadcastAddresses();
+
+    // Local ip to broadcast address.
+    QHash<QHostAddress, QHostAddress> m_addresses;
+    QList<QHostAddress> m_broadcastAddresses;
+    QTimer *m_announceTimer;
+
+#ifdef Q_OS_LINUX
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QHash<int, bool> m_linkRunning;
+#else
+    QTimer *m_timer;
+#endif
+};
+
+#endif // !INTERFACE_MONITOR_H
@@ -42,6 +42,7 @@ int main(int argc, char *argv[])
     qInstallMessageHandler(myMessageOutput);
 
     qRegisterMetaType<Msg>("Msg");
+    qRegisterMetaType<QList<Owner> >("QList<Owner>");
     qRegisterMetaType<QAbstractSocket::SocketError>("QAbstractSocket::SocketError");
 
     // Create application home directory
@@ -81,12 +82,17 @@ int main(int argc, char *argv[])
         usleep(200000);
     }
 
+    Global::userManager->loadPresenceCache();
     Global::userManager->broadcastEntry();
 
     app.setQuitOnLastWindowClosed(false);
     int rc = app.exec();
+    if (Global::msgThread->hasFatalError()) {
+        rc = -1;
+    }
 
     Global::userManager->broadcastExit();
+    Global::userManager->savePresenceCache();
 
     delete qipmsg;
 
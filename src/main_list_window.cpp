@@ -342,8 +342,7 @@ void MainListWindow::selectUser()
 
 void MainListWindow::refreshUserList()
 {
-    Global::userManager->m_model
-        ->removeRows(0, Global::userManager->m_model->rowCount());
+    Global::userManager->clearUsers();
     updateUserCount(0);
 
     Global::userManager->broadcastEntry();
@@ -340,6 +340,12 @@ void MainWindow::sendMessage()
         flags |= IPMSG_MULTICASTOPT;
     }
 
+    // Stat the files once, the transfers of all recipients share them.
+    SendFileSet sendFileSet;
+    if (hasSendFile()) {
+        sendFileSet = SendFileSet(m_sendFileModel.pathList());
+    }
+
     foreach (QModelIndex index, modelIndexList) {
         QString ip = proxyUserModel->data(index).toString();
         QString recvUser = proxyUserModel->data(
@@ -353,15 +359,13 @@ void MainWindow::sendMessage()
         additionalInfo.append(QChar('\0'));
 
         if (hasSendFile()) {
-            // we need to realloc memory when send file to mulitple user.
+            // every recipient gets its own ticket on the shared files.
             // we don't delete this, sendFileManager take care of it.
-            m_sendFileMap = new SendFileMap;
+            m_sendFileMap = new SendFileMap(sendFileSet);
 
             flags |= IPMSG_FILEATTACHOPT;
 
-            QStringList pathList = m_sendFileModel.pathList();
-            m_sendFileMap->addFile(pathList);
-            additionalInfo.append(m_sendFileMap->packetString());
+            additionalInfo.append(sendFileSet.packetString());
             additionalInfo.append(QChar('\0'));
         }
 
@@ -376,9 +380,9 @@ void MainWindow::sendMessage()
         if (hasSendFile()) {
             m_sendFileMap->setRecvUser(recvUser);
             m_sendFileMap->setRecvHostname(recvHostname);
-            m_sendFileMap->setPacketNoString(sendMsg.packetNoString());
+            m_sendFileMap->setPacketNo(sendMsg.packetNo());
             Global::sendFileManager
-                ->addTransferLocked(m_sendFileMap->packetNoString(),
+                ->addTransferLocked(m_sendFileMap->packetNo(),
                          m_sendFileMap);
 
         }
@@ -547,8 +551,7 @@ void MainWindow::logSendMsg(QString text, int row)
 
 void MainWindow::refreshUserList()
 {
-    Global::userManager->m_model
-        ->removeRows(0, Global::userManager->m_model->rowCount());
+    Global::userManager->clearUsers();
     updateUserCount(0);
 
     Global::userManager->broadcastEntry();
@@ -0,0 +1,84 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <QAtomicPointer>
+#include <QList>
+
+// Lock-free multi producer single consumer queue. Producers push onto an
+// atomic list head, the consumer takes whole list at once and reverses it,
+// so there is no ABA problem and push never blocks.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() {}
+    ~MpscQueue()
+    {
+        QList<T> values;
+        takeAll(values);
+    }
+
+    // May be called in any thread. Return true if queue was empty, then
+    // the consumer should be waked.
+    bool push(const T &value)
+    {
+        Node *node = new Node(value);
+        Node *head;
+        do {
+            head = m_head.loadAcquire();
+            node->next = head;
+        } while (!m_head.testAndSetOrdered(head, node));
+
+        return head == 0;
+    }
+
+    // Consumer thread only. Append all values to 'values' in push order.
+    void takeAll(QList<T> &values)
+    {
+        Node *node = m_head.fetchAndStoreOrdered(0);
+
+        Node *prev = 0;
+        while (node) {
+            Node *next = node->next;
+            node->next = prev;
+            prev = node;
+            node = next;
+        }
+
+        while (prev) {
+            values << prev->value;
+            Node *next = prev->next;
+            delete prev;
+            prev = next;
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(MpscQueue)
+
+    struct Node {
+        Node(const T &value) : value(value), next(0) {}
+        T value;
+        Node *next;
+    };
+
+    QAtomicPointer<Node> m_head;
+};
+
+#endif // !MPSC_QUEUE_H
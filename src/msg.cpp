@@ -18,17 +18,19 @@
 
 Msg& Msg::operator=(const Msg &rhs)
 {
-    ++*rhs.use;
+    if (rhs.p) {
+        rhs.p->m_use.ref();
+    }
     decr_use();
 
     p = rhs.p;
-    use = rhs.use;
 
     return *this;
 }
 
 Msg::Msg(const MsgBase &m)
-    : p(m.clone()), use(new qint32(1))
+    : p(m.clone())
 {
+    p->m_use.ref();
 }
 
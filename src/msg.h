@@ -23,16 +23,24 @@
 #include <stdexcept>
 
 
-// Use counted handle class for the msg_base hierarchy
+// Use counted handle class for the msg_base hierarchy. The use count lives
+// in MsgBase and is atomic, so handles may be copied in any thread, e.g. by
+// queued signals.
 class Msg
 {
 public:
     // default constructor: unbound handle
-    Msg() : p(0), use(new qint32(1)) {}
+    Msg() : p(0) {}
     // attach a handle to a copy of the MsgBase object
     Msg(const MsgBase&);
+    // attach a handle to a new allocated MsgBase object, without copy
+    explicit Msg(MsgBase *m) : p(m) { if (p) p->m_use.ref(); }
     // copy control members to manage the use count and pointers
-    Msg(const Msg &m): p(m.p), use(m.use) { ++*use; }
+    Msg(const Msg &m): p(m.p) { if (p) p->m_use.ref(); }
+#ifdef Q_COMPILER_RVALUE_REFS
+    Msg(Msg &&m) : p(m.p) { m.p = 0; }
+    Msg& operator=(Msg &&m) { qSwap(p, m.p); return *this; }
+#endif
 
     ~Msg() { decr_use(); }
     Msg& operator=(const Msg&);
@@ -60,13 +68,12 @@ public:
     }
 
 private:
-    MsgBase *p;             // pointer to shared item
-    qint32 *use;       // pointer to shared use count
+    MsgBase *p;             // pointer to shared item, holds use count
 
     // called by both destructor and assignment operator for free pointers
     void decr_use() {
-        if (--*use == 0) {
-            delete p; delete use;
+        if (p && !p->m_use.deref()) {
+            delete p;
         }
     }
 };
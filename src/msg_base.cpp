@@ -19,15 +19,23 @@
 #include "global.h"
 #include "user_manager.h"
 #include "constants.h"
+#include "packet_parser.h"
+#include "transfer_codec.h"
 
-#include <QStringList>
-
-
-MsgBase::MsgBase(QString packet, QHostAddress address, quint16 port)
-    : m_owner(packet, address, port), m_packet(packet),
-    m_ipAddress(address), m_port(port)
+// XXX NOTE: m_packet is only used to send, it is left empty here.
+MsgBase::MsgBase(const PacketParser &parser, QHostAddress address,
+                 quint16 port)
+    : m_owner(parser, address, port), m_ipAddress(address), m_port(port)
 {
-    parsePacket();
+    QTextCodec *codec = Global::transferCodec->codec();
+
+    m_additionalInfo = parser.toString(PacketParser::AdditionalInfo, codec);
+    m_extendedInfo = parser.toString(PacketParser::ExtendedInfo, codec);
+    m_packetNo = parser.toLongLong(PacketParser::PacketNo);
+    m_packetNoString = QString::fromLatin1(
+            parser.fieldData(PacketParser::PacketNo),
+            parser.fieldSize(PacketParser::PacketNo));
+    m_flags = parser.flags();
 }
 
 MsgBase::MsgBase(QHostAddress address, quint16 port, QString additionalInfo,
@@ -35,7 +43,7 @@ MsgBase::MsgBase(QHostAddress address, quint16 port, QString additionalInfo,
     : m_ipAddress(address), m_port(port), m_additionalInfo(additionalInfo),
     m_extendedInfo(extendedInfo), m_flags(flags)
 {
-    m_packetNoString = Helper::packetNoString();
+    m_packetNo = Helper::packetNo();
     m_owner = Global::userManager->ourself();
 
     constructPacket();
@@ -49,7 +57,7 @@ void MsgBase::constructPacket()
 {
     m_packet.append(QString("%1%2").arg(IPMSG_VERSION).arg(COMMAND_SEPERATOR));
 
-    m_packet.append(QString("%1%2").arg(m_packetNoString)
+    m_packet.append(QString("%1%2").arg(m_packetNo)
                     .arg(COMMAND_SEPERATOR));
 
     m_packet.append(m_owner.loginName());
@@ -59,41 +67,3 @@ void MsgBase::constructPacket()
     m_packet.append(QString("%1%2").arg(m_flags).arg(COMMAND_SEPERATOR));
     m_packet.append(m_additionalInfo);
 }
-
-void MsgBase::parsePacket()
-{
-    QStringList list = m_packet.split(COMMAND_SEPERATOR);
-
-    // sanity check
-    if (list.count() < MSG_NORMAL_FIELD_COUNT) {
-        return;
-    }
-
-    m_extendedInfo = m_packet.section(QChar(EXTEND_INFO_SEPERATOR), 1, 1);
-    parseAdditionalInfo();
-
-    m_packetNoString = list.at(MSG_PACKET_NO_POS);
-    m_flags = list.at(MSG_FLAGS_POS).toUInt();
-}
-
-void MsgBase::parseAdditionalInfo()
-{
-    int cnt = 0;
-    int index = 0;
-    while (cnt < MSG_ADDITION_INFO_POS) {
-        int id = m_packet.indexOf(QChar(COMMAND_SEPERATOR), index);
-        if (index == -1) {
-            break;
-        }
-        ++cnt;
-        index = id + 1;
-    }
-
-    if (index == -1) {
-        m_additionalInfo = "";
-    } else {
-        QString s = m_packet.right(m_packet.size() - index);
-        m_additionalInfo = s.section(QChar(EXTEND_INFO_SEPERATOR), 0, 0);
-    }
-}
-
@@ -18,9 +18,12 @@
 #define MSG_BASE_H
 
 #include <QHostAddress>
+#include <QAtomicInt>
 
 #include "owner.h"
 
+class PacketParser;
+
 class MsgBase
 {
 public:
@@ -30,8 +33,8 @@ public:
 
     MsgBase() {}
 
-    // Create receive message from receive packet
-    MsgBase(QString packet, QHostAddress address, quint16 port);
+    // Create receive message from parsed receive packet
+    MsgBase(const PacketParser &parser, QHostAddress address, quint16 port);
 
     // Create send message
     MsgBase(QHostAddress address, quint16 port, QString additionalInfo,
@@ -43,7 +46,13 @@ public:
 
     virtual QString packet() const { return m_packet; }
 
-    virtual QString packetNoString() const { return m_packetNoString; }
+    virtual qint64 packetNo() const { return m_packetNo; }
+    // Text of packet number, only for wire and display. Received msgs keep
+    // the text of the peer, so acks echo exactly the id it sent.
+    virtual QString packetNoString() const {
+        return m_packetNoString.isEmpty() ? QString::number(m_packetNo)
+                                          : m_packetNoString;
+    }
 
     virtual quint32 flags() const { return m_flags; }
 
@@ -65,18 +74,28 @@ public:
     virtual void incrementSendTimes() {}
 
 private:
-    void parsePacket();
-    void parseAdditionalInfo();
+    friend class Msg;
+
+    // Use count of Msg handles. A copy of MsgBase is a new object, so the
+    // count is not copied.
+    struct UseCount : public QAtomicInt {
+        UseCount() : QAtomicInt(0) {}
+        UseCount(const UseCount &) : QAtomicInt(0) {}
+        UseCount &operator=(const UseCount &) { return *this; }
+    };
+
     void constructPacket();
 
     Owner m_owner;
     QString m_packet;
     QString m_extendedInfo;
     QString m_additionalInfo;
+    qint64 m_packetNo;
     QString m_packetNoString;
     quint32 m_flags;
     QHostAddress m_ipAddress;
     quint16 m_port;
+    UseCount m_use;
 };
 
 #endif // !MSG_BASE_H
@@ -23,59 +23,70 @@
 #include "preferences.h"
 #include "user_manager.h"
 #include "send_file_manager.h"
+#include "packet_parser.h"
 
-#include <QMutexLocker>
 #include <QTextCodec>
-#include <QNetworkInterface>
 #include <QAbstractSocket>
 #include <QSet>
 
 MsgServer::MsgServer(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+    m_timerWheel(SEND_MSG_TIMER_TICK, SEND_MSG_TIMER_SLOTS),
+    m_isMulticastDiscovery(false)
 {
-    updateAddresses();
+    connect(&m_interfaceMonitor, SIGNAL(changed()),
+            this, SLOT(updateAddresses()));
+    connect(&m_interfaceMonitor, SIGNAL(interfaceUp()),
+            this, SLOT(announceEntry()));
 
-    connect(&m_udpSocket, SIGNAL(readyRead()),
+    connect(&m_socket, SIGNAL(readyRead()),
             this, SLOT(readPacket()));
-    connect(this, SIGNAL(releaseFile(QString)),
-            Global::sendFileManager, SLOT(removeTransferLocked(QString)));
-    connect(&m_udpSocket, SIGNAL(error(QAbstractSocket::SocketError)),
-            this, SLOT(socketEerror(QAbstractSocket::SocketError)));
+    connect(this, SIGNAL(releaseFile(qint64)),
+            Global::sendFileManager, SLOT(removeTransferLocked(qint64)));
+    connect(&m_socket, SIGNAL(error(QAbstractSocket::SocketError, QString)),
+            this, SIGNAL(error(QAbstractSocket::SocketError, QString)));
+    connect(&m_timerWheel, SIGNAL(expired()),
+            this, SLOT(processExpiredMsg()));
+    connect(&m_entryResponder,
+            SIGNAL(sendAnsEntry(const QHostAddress &, quint16)),
+            this, SLOT(sendAnsEntry(const QHostAddress &, quint16)));
+
+    m_clock.start();
 }
 
 void MsgServer::start()
 {
-    m_udpSocket.bind(QHostAddress::Any, IPMSG_DEFAULT_PORT);
+    m_socket.bind(IPMSG_DEFAULT_PORT);
+
+    // Multicast groups can only be joined once bound.
+    m_interfaceMonitor.start();
+    updateAddresses();
 }
 
 void MsgServer::readPacket()
 {
     qDebug() << "MsgServer::readPacket";
 
-    while (m_udpSocket.hasPendingDatagrams()) {
-        QHostAddress senderIp;
-        quint16 senderPort;
-        QByteArray datagram;
-        datagram.resize(m_udpSocket.pendingDatagramSize());
-        if (m_udpSocket.readDatagram(datagram.data(), datagram.size(),
-                                         &senderIp, &senderPort) == -1) {
-            continue;
-        }
+    // Drain socket a batch at a time, so a login storm does not overflow
+    // socket receive buffer while we are busy.
+    QList<MsgSocket::Datagram> datagrams;
+    while (m_socket.readDatagrams(datagrams) > 0) {
+        foreach (const MsgSocket::Datagram &datagram, datagrams) {
+            PacketParser parser;
+            if (!parser.parse(datagram.data.constData(),
+                              datagram.data.size())
+                || !isSupportedCommand(parser.flags())) {
+                continue;
+            }
 
-        if (!isSupportedCommand(datagram)) {
-            continue;
+            processRecvMsg(Msg(new RecvMsg(parser, datagram.address,
+                                           datagram.port)));
         }
-
-        QString packet
-            = Global::transferCodec->codec()->toUnicode(datagram);
-
-        RecvMsg recvMsg(packet, senderIp, senderPort);
-
-        processRecvMsg(Msg(recvMsg));
+        datagrams.clear();
     }
 }
 
-void MsgServer::processRecvMsg(Msg msg)
+void MsgServer::processRecvMsg(const Msg &msg)
 {
     qDebug() << "MsgServer::processRecvMsg";
 
@@ -104,8 +115,11 @@ void MsgServer::processRecvMsg(Msg msg)
         processRecvReadMsg(msg);
         break;
 
-    case IPMSG_ANSREADMSG:
     case IPMSG_RECVMSG:
+        processRecvRecvMsg(msg);
+        break;
+
+    case IPMSG_ANSREADMSG:
     case IPMSG_DELMSG:
         // do nothing
         // XXX TODO: do something?????????
@@ -115,76 +129,397 @@ void MsgServer::processRecvMsg(Msg msg)
         processRecvReleaseFilesMsg(msg);
         break;
 
+    case IPMSG_BR_ISGETLIST:
+    case IPMSG_BR_ISGETLIST2:
+        processRecvIsGetListMsg(msg);
+        break;
+
+    case IPMSG_OKGETLIST:
+        processRecvOkGetListMsg(msg);
+        break;
+
+    case IPMSG_GETLIST:
+        processRecvGetListMsg(msg);
+        break;
+
+    case IPMSG_ANSLIST:
+        processRecvAnsListMsg(msg);
+        break;
+
     default:
         break;
     }
 }
 
-void MsgServer::processEntryMsg(Msg msg)
+bool MsgServer::isOurAddress(const QHostAddress &address) const
+{
+    return m_interfaceMonitor.addresses().contains(address);
+}
+
+void MsgServer::sendListMsg(const Msg &msg, QString additionalInfo,
+                            quint32 flags)
+{
+    Global::msgThread->addSendMsg(Msg(new SendMsg(msg->ipAddress(),
+                    msg->port(), additionalInfo, ""/* extendedInfo */,
+                    flags)));
+}
+
+// A peer looks for a list server.
+void MsgServer::processRecvIsGetListMsg(const Msg &msg)
+{
+    if (Global::preferences->isListServer && !isOurAddress(msg->ipAddress())) {
+        sendListMsg(msg, "", IPMSG_OKGETLIST);
+    }
+}
+
+// Take the first list server answering, and ask it for the first page.
+void MsgServer::processRecvOkGetListMsg(const Msg &msg)
+{
+    if (!m_listServer.isNull() || Global::preferences->isListServer) {
+        return;
+    }
+
+    m_listServer = msg->ipAddress();
+    sendListMsg(msg, "0", IPMSG_GETLIST);
+}
+
+// Answer with one page of our peer table, starting at the index asked.
+// Page is "start\atotal\a" followed by entries of
+// "login\ahost\aflags\aip\aport\aname\agroup\a", empty fields are
+// HOSTLIST_DUMMY.
+void MsgServer::processRecvGetListMsg(const Msg &msg)
+{
+    if (!Global::preferences->isListServer) {
+        return;
+    }
+
+    int start = msg->additionalInfo().trimmed().toInt();
+    qint64 now = m_clock.elapsed();
+
+    QHash<QString, HostList>::iterator it = m_hostLists.begin();
+    while (it != m_hostLists.end()) {
+        if (now - it->time > HOSTLIST_SNAPSHOT_TTL) {
+            it = m_hostLists.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    const QString requester = msg->ip();
+    if (start == 0 || !m_hostLists.contains(requester)) {
+        HostList hostList;
+        hostList.owners = Global::userManager->onlinePeers();
+        hostList.time = now;
+        m_hostLists.insert(requester, hostList);
+    }
+    const QList<Owner> owners = m_hostLists.value(requester).owners;
+    start = qBound(0, start, owners.size());
+
+    // XXX NOTE: page limit is on the wire, so count encoded bytes.
+    QTextCodec *codec = Global::transferCodec->codec();
+    const QChar sep(HOSTLIST_SEPARATOR);
+    QString page = QString::number(start) + sep
+        + QString::number(owners.size()) + sep;
+    int pageBytes = codec->fromUnicode(page).size();
+
+    for (int i = start; i < owners.size(); ++i) {
+        const Owner &owner = owners.at(i);
+
+        QStringList fields;
+        fields << owner.loginName() << owner.host()
+            << QString::number(IPMSG_BR_ENTRY | QIPMSG_CAPACITY)
+            << owner.ip() << QString::number(owner.port())
+            << owner.name() << owner.group();
+
+        QString entry;
+        foreach (const QString &field, fields) {
+            entry += (field.isEmpty() ? QString(HOSTLIST_DUMMY) : field) + sep;
+        }
+
+        // Rest goes to next page, the first entry always fits.
+        int entryBytes = codec->fromUnicode(entry).size();
+        if (pageBytes + entryBytes > HOSTLIST_PAGE_SIZE && i > start) {
+            break;
+        }
+        page += entry;
+        pageBytes += entryBytes;
+    }
+
+    sendListMsg(msg, page, IPMSG_ANSLIST);
+}
+
+void MsgServer::processRecvAnsListMsg(const Msg &msg)
+{
+    if (msg->ipAddress() != m_listServer) {
+        return;
+    }
+
+    QStringList fields
+        = msg->additionalInfo().split(QChar(HOSTLIST_SEPARATOR));
+    if (fields.size() < 2) {
+        return;
+    }
+
+    int start = fields.at(0).trimmed().toInt();
+    int total = fields.at(1).trimmed().toInt();
+
+    QList<Owner> owners;
+    int count = 0;
+    for (int i = 2; i + 7 <= fields.size(); i += 7, ++count) {
+        for (int j = i; j < i + 7; ++j) {
+            if (fields.at(j) == HOSTLIST_DUMMY) {
+                fields[j].clear();
+            }
+        }
+
+        QHostAddress address(fields.at(i + 3));
+        if (address.isNull() || isOurAddress(address)) {
+            continue;
+        }
+
+        Owner owner;
+        owner.setLoginName(fields.at(i));
+        owner.setHost(fields.at(i + 1));
+        owner.setIpAddress(address);
+        owner.setPort(fields.at(i + 4).toUShort());
+        owner.setName(fields.at(i + 5).isEmpty() ? fields.at(i)
+                      : fields.at(i + 5));
+        owner.setGroup(fields.at(i + 6));
+        owners << owner;
+    }
+
+    if (!owners.isEmpty()) {
+        emit newUserList(owners);
+    }
+
+    if (count > 0 && start + count < total) {
+        sendListMsg(msg, QString::number(start + count), IPMSG_GETLIST);
+    }
+}
+
+void MsgServer::processEntryMsg(const Msg &msg)
 {
     emit newUserMsg(msg);
 
-    SendMsg sendMsg(msg->ipAddress(), msg->port(),
+    m_entryResponder.respond(msg->ipAddress(), msg->port(),
+                             Global::userManager->peerCount());
+}
+
+// A new interface came up, tell peers on it we are here.
+void MsgServer::announceEntry()
+{
+    Global::userManager->broadcastEntry();
+}
+
+void MsgServer::sendAnsEntry(const QHostAddress &address, quint16 port)
+{
+    qDebug("MsgServer::sendAnsEntry: %llu sent, %llu suppressed",
+           m_entryResponder.sentCount(), m_entryResponder.suppressedCount());
+
+    Global::msgThread->addSendMsg(Msg(new SendMsg(address, port,
                     Global::userManager->entryMessage(),
-                    ""/* extendedInfo */, IPMSG_ANSENTRY);
+                    ""/* extendedInfo */, IPMSG_ANSENTRY)));
+}
+
+void MsgServer::processRecvReleaseFilesMsg(const Msg &msg)
+{
+    bool ok;
+    qint64 packetNo = msg->additionalInfo().trimmed().toLongLong(&ok);
+    if (ok) {
+        emit releaseFile(packetNo);
+    }
+}
+
+// Ack of our IPMSG_SENDMSG, additionalInfo is its packet number.
+void MsgServer::processRecvRecvMsg(const Msg &msg)
+{
+    bool ok;
+    qint64 packetNo = msg->additionalInfo().trimmed().toLongLong(&ok);
+    if (!ok) {
+        return;
+    }
+
+    QHash<qint64, Msg>::iterator it = m_sendMsgMap.find(packetNo);
+    if (it == m_sendMsgMap.end() || it.value()->ipAddress() != msg->ipAddress()) {
+        return;
+    }
+
+    Msg sendMsg = it.value();
+    // XXX NOTE: ack of a retransmitted msg may be of any transmission, only
+    // sample RTT of msgs sent once.
+    if (sendMsg->sendTimes() == 1 && m_firstSendTimes.contains(packetNo)) {
+        updateRtt(sendMsg->ip(),
+                  m_clock.elapsed() - m_firstSendTimes.value(packetNo));
+    }
+    m_firstSendTimes.remove(packetNo);
+
+    sendMsg->setState(MsgBase::SendAckOk);
+    // Its pending deadline in m_timerWheel will find nothing.
+    m_sendMsgMap.erase(it);
 
-    Global::msgThread->addSendMsg(Msg(sendMsg));
+    emit sendMsgAcked(sendMsg);
 }
 
-void MsgServer::processRecvReleaseFilesMsg(Msg msg)
+void MsgServer::updateRtt(const QString &ip, int rtt)
 {
-    emit releaseFile(msg->additionalInfo());
+    QHash<QString, PeerRtt>::iterator it = m_peerRtts.find(ip);
+    if (it == m_peerRtts.end()) {
+        PeerRtt peerRtt;
+        peerRtt.srtt = rtt;
+        peerRtt.rttvar = rtt / 2;
+        m_peerRtts.insert(ip, peerRtt);
+        return;
+    }
+
+    // RFC 6298
+    it->rttvar = (3 * it->rttvar + qAbs(it->srtt - rtt)) / 4;
+    it->srtt = (7 * it->srtt + rtt) / 8;
 }
 
-void MsgServer::processRecvReadMsg(Msg msg)
+// Timeout before next retransmission, doubled on each one.
+int MsgServer::retransmitTimeout(Msg &msg) const
+{
+    int rto = SEND_MSG_INITIAL_RTO;
+    QHash<QString, PeerRtt>::const_iterator it = m_peerRtts.find(msg->ip());
+    if (it != m_peerRtts.end()) {
+        rto = qBound(SEND_MSG_MIN_RTO, it->srtt + 4 * it->rttvar,
+                     SEND_MSG_MAX_RTO);
+    }
+
+    int shift = qMin(msg->sendTimes() - 1, 8);
+    return qMin(rto << shift, SEND_MSG_MAX_RTO);
+}
+
+void MsgServer::processRecvReadMsg(const Msg &msg)
 {
     if (Global::preferences->isReadCheck) {
         emit newMsg(msg);
     }
+    emit sendMsgReaded(msg);
 
-    SendMsg sendMsg(msg->ipAddress(), msg->port(), msg->packetNoString(),
-                    ""/* extendedInfo */, IPMSG_ANSREADMSG);
-
-    Global::msgThread->addSendMsg(Msg(sendMsg));
+    Global::msgThread->addSendMsg(Msg(new SendMsg(msg->ipAddress(),
+                    msg->port(), msg->packetNoString(),
+                    ""/* extendedInfo */, IPMSG_ANSREADMSG)));
 }
 
-void MsgServer::processRecvSendMsg(Msg msg)
+void MsgServer::processRecvSendMsg(const Msg &msg)
 {
     if (GET_OPT(msg->flags()) & IPMSG_SENDCHECKOPT) {
-        SendMsg sendMsg(msg->ipAddress(), msg->port(), msg->packetNoString(),
-                ""/* extendedInfo */, IPMSG_RECVMSG);
+        Global::msgThread->addSendMsg(Msg(new SendMsg(msg->ipAddress(),
+                        msg->port(), msg->packetNoString(),
+                        ""/* extendedInfo */, IPMSG_RECVMSG)));
+    }
 
-        Global::msgThread->addSendMsg(Msg(sendMsg));
+    // Our RECVMSG was lost or late, it is acked again above, but only
+    // shown once.
+    if (isDuplicateRecvMsg(msg)) {
+        return;
     }
 
     // If sender is not in our user list, add it.
-    if (!Global::userManager->contains(msg->ip())) {
+    if (!Global::userManager->contains(msg->ipAddress())) {
         emit newUserMsg(msg);
     }
 
     emit newMsg(msg);
 }
 
+// Remember 'msg', return true if it was already received.
+bool MsgServer::isDuplicateRecvMsg(const Msg &msg)
+{
+    QString key = msg->ip() + COMMAND_SEPERATOR + msg->packetNoString();
+    if (m_recentRecvMsgs.contains(key)) {
+        return true;
+    }
+
+    m_recentRecvMsgs.insert(key);
+    m_recentRecvMsgOrder.enqueue(key);
+    if (m_recentRecvMsgOrder.size() > RECENT_RECV_MSG_COUNT) {
+        m_recentRecvMsgs.remove(m_recentRecvMsgOrder.dequeue());
+    }
+
+    return false;
+}
+
 void MsgServer::processSendMsg()
 {
     // We are a friend of MsgThread class
-    QMutexLocker locker(&Global::msgThread->m_lock);
+    // Only new msgs, resending is driven by m_timerWheel.
+    QList<Msg> msgs;
+    Global::msgThread->m_newSendMsgs.takeAll(msgs);
+    for (int i = 0; i < msgs.size(); ++i) {
+        m_sendMsgMap.insert(msgs.at(i)->packetNo(), msgs.at(i));
+        handleMsg(msgs[i]);
+    }
+
+    flushSendMsg();
+}
 
-    foreach (Msg msg, Global::msgThread->m_sendMsgMap) {
-        handleMsg(msg);
+void MsgServer::processExpiredMsg()
+{
+    foreach (qint64 packetNo, m_timerWheel.takeExpired()) {
+        QHash<qint64, Msg>::iterator it = m_sendMsgMap.find(packetNo);
+        if (it != m_sendMsgMap.end()) {
+            Msg msg = it.value();
+            handleMsg(msg);
+        }
     }
+
+    flushSendMsg();
+}
+
+// Send all msgs queued by handleMsg() in batches, and update their state.
+void MsgServer::flushSendMsg()
+{
+    QVector<bool> results;
+    m_socket.flush(results);
+
+    for (int i = 0; i < m_sendingMsgs.size(); ++i) {
+        Msg &msg = m_sendingMsgs[i].second;
+        qint64 packetNo = msg->packetNo();
+        if (!m_sendMsgMap.contains(packetNo)) {
+            // Fire and forget msg, or acked meanwhile.
+            msg->setState(results.at(m_sendingMsgs.at(i).first)
+                          ? MsgBase::SendOk : MsgBase::SendFail);
+            continue;
+        }
+
+        if (results.at(m_sendingMsgs.at(i).first)) {
+            msg->setState(MsgBase::SendOk);
+            if (isAckNeeded(msg)) {
+                if (msg->sendTimes() == 1) {
+                    m_firstSendTimes.insert(packetNo, m_clock.elapsed());
+                }
+                m_timerWheel.schedule(packetNo, retransmitTimeout(msg));
+            } else {
+                m_sendMsgMap.remove(packetNo);
+            }
+        } else {
+            msg->setState(MsgBase::SendFail);
+            // Retry later.
+            m_timerWheel.schedule(packetNo, SEND_MSG_RETRY_INTERVAL);
+        }
+    }
+
+    m_sendingMsgs.clear();
 }
 
 void MsgServer::handleMsg(Msg &msg)
 {
     // Delete msg
     if (msg->state() == MsgBase::SendAckOk) {
-        Global::msgThread->removeSendMsgNotLock(msg->packetNoString());
+        m_sendMsgMap.remove(msg->packetNo());
+        return;
     }
 
     // Delete msg
     if (msg->sendTimes() >= MAX_RE_SEND_TIMES) {
-        Global::msgThread->removeSendMsgNotLock(msg->packetNoString());
+        m_sendMsgMap.remove(msg->packetNo());
+        if (isAckNeeded(msg)) {
+            m_firstSendTimes.remove(msg->packetNo());
+            emit sendMsgLost(msg);
+        }
+        return;
     }
 
     // Send msg
@@ -199,81 +534,124 @@ void MsgServer::handleMsg(Msg &msg)
         case IPMSG_BR_EXIT:
         case IPMSG_BR_ABSENCE:
             broadcastUserMsg(msg);
-            Global::msgThread->removeSendMsgNotLock(msg->packetNoString());
+            m_sendMsgMap.remove(msg->packetNo());
+            break;
+
+        case IPMSG_BR_ISGETLIST2:
+            // Listen to the list servers answering this one.
+            m_listServer.clear();
+            broadcastUserMsg(msg);
+            m_sendMsgMap.remove(msg->packetNo());
             break;
 
         case IPMSG_ANSENTRY:
         case IPMSG_ANSREADMSG:
         case IPMSG_RELEASEFILES:
+        case IPMSG_OKGETLIST:
+        case IPMSG_GETLIST:
+        case IPMSG_ANSLIST:
             broadcastMsg(msg);
-            Global::msgThread->removeSendMsgNotLock(msg->packetNoString());
+            m_sendMsgMap.remove(msg->packetNo());
             break;
 
-
+        // Kept until sent, and for IPMSG_SENDCHECKOPT until acked, see
+        // flushSendMsg().
         case IPMSG_READMSG:
-            broadcastMsg(msg);
-            // XXX TODO: If IPMSG_READCHECKOPT is on, we need to check if
-            // sucessfully sended.
-            break;
-
         case IPMSG_RECVMSG:
-            broadcastMsg(msg);
-            // XXX TODO: need to check if sucessfully sended.
-            break;
-
         case IPMSG_SENDMSG:
             broadcastMsg(msg);
-            // XXX TODO: need to check if sucessfully sended.
             break;
 
         default:
-            Global::msgThread->removeSendMsgNotLock(msg->packetNoString());
+            m_sendMsgMap.remove(msg->packetNo());
             break;
         }
     }
 }
 
+// Resend on local failure, or when no ack came before timeout.
 bool MsgServer::isResendNeeded(Msg &msg) const
 {
-    if (msg->state() == MsgBase::SendFail
-        && msg->sendTimes() < MAX_RE_SEND_TIMES) {
+    if (msg->sendTimes() >= MAX_RE_SEND_TIMES) {
+        return false;
+    }
+
+    if (msg->state() == MsgBase::SendFail) {
+        return true;
+    }
+
+    if (msg->state() == MsgBase::SendOk && isAckNeeded(msg)) {
         return true;
     }
 
     return false;
 }
 
+bool MsgServer::isAckNeeded(Msg &msg) const
+{
+    return GET_MODE(msg->flags()) == IPMSG_SENDMSG
+        && (GET_OPT(msg->flags()) & IPMSG_SENDCHECKOPT)
+        && !(GET_OPT(msg->flags()) & IPMSG_BROADCASTOPT);
+}
+
 void MsgServer::broadcastMsg(Msg &msg)
 {
     QByteArray datagram
         = Global::transferCodec->codec()->fromUnicode(msg->packet());
 
-    if (m_udpSocket.writeDatagram(datagram, msg->ipAddress(),
-                                       msg->port()) == -1) {
-        msg->setState(MsgBase::SendFail);
-    } else { // Send Ok
-        msg->setState(MsgBase::SendOk);
-    }
+    // State is updated by flushSendMsg() after it is really sent.
+    int index = m_socket.queueDatagram(datagram, msg->ipAddress(),
+                                       msg->port());
+    m_sendingMsgs << qMakePair(index, msg);
 }
 
+// Called when interfaces or address settings change, never per broadcast.
 void MsgServer::updateAddresses()
 {
+    m_isMulticastDiscovery = Global::preferences->isMulticastDiscovery;
+    m_multicastGroupName = Global::preferences->multicastGroup;
+    m_multicastInterfaceList = Global::preferences->multicastInterfaceList;
+
+    QHostAddress group = multicastGroup();
+
+    // Leave what is no longer wanted first, the group may have changed.
+    QList<QHostAddress> joined;
+    foreach (const QHostAddress &address, m_multicastInterfaces) {
+        if (group == m_multicastGroup
+                && m_interfaceMonitor.addresses().contains(address)
+                && isMulticastInterface(address)) {
+            joined << address;
+        } else {
+            m_socket.leaveMulticastGroup(m_multicastGroup, address);
+        }
+    }
+    m_multicastGroup = group;
+
+    // Interfaces failing to join fall back to broadcast.
     m_broadcastAddresses.clear();
-    m_ipAddresses.clear();
-
-    foreach (QNetworkInterface interface, QNetworkInterface::allInterfaces()) {
-        foreach (QNetworkAddressEntry entry, interface.addressEntries()) {
-            QHostAddress broadcastAddress = entry.broadcast();
-            if (broadcastAddress != QHostAddress::Null &&
-                entry.ip() != QHostAddress::LocalHost) {
-                m_broadcastAddresses << broadcastAddress;
-                m_ipAddresses << entry.ip();
+    QHash<QHostAddress, QHostAddress>::const_iterator it;
+    for (it = m_interfaceMonitor.addresses().constBegin();
+         it != m_interfaceMonitor.addresses().constEnd(); ++it) {
+        if (!group.isNull() && isMulticastInterface(it.key())) {
+            if (joined.contains(it.key())) {
+                continue;
             }
+            if (m_socket.joinMulticastGroup(group, it.key())) {
+                joined << it.key();
+                continue;
+            }
+            qWarning("MsgServer::updateAddresses: join %s on %s: %s",
+                     group.toString().toUtf8().data(),
+                     it.key().toString().toUtf8().data(),
+                     m_socket.errorString().toUtf8().data());
         }
+        m_broadcastAddresses << it.value();
     }
+    m_multicastInterfaces = joined;
 
     // Add broadcast address specified by user.
-    foreach(QString s, Global::preferences->userSpecifiedBroadcastIpList) {
+    m_userBroadcastIpList = Global::preferences->userSpecifiedBroadcastIpList;
+    foreach(QString s, m_userBroadcastIpList) {
         QHostAddress h(s);
         if (h != QHostAddress::Null &&
             h != QHostAddress::LocalHost &&
@@ -292,37 +670,69 @@ void MsgServer::broadcastUserMsg(Msg &msg)
 {
     qDebug() << "MsgServer::broadcastUserMsg";
 
-    updateAddresses();
+    if (isAddressSettingChanged()) {
+        updateAddresses();
+    }
 
     QByteArray datagram = Global::transferCodec->codec()
         ->fromUnicode(msg->packet());
-    bool validBroadcastAddresses = true;
     foreach (QHostAddress address, m_broadcastAddresses) {
-        if (m_udpSocket.writeDatagram(datagram, address,
-                                       IPMSG_DEFAULT_PORT) == -1) {
-            validBroadcastAddresses = false;
-        }
+        m_socket.queueDatagram(datagram, address, IPMSG_DEFAULT_PORT);
     }
 
-    if (!validBroadcastAddresses) {
-        updateAddresses();
+    // Rare enough to be sent at once.
+    foreach (const QHostAddress &address, m_multicastInterfaces) {
+        if (!m_socket.sendMulticast(datagram, m_multicastGroup,
+                                    IPMSG_DEFAULT_PORT, address)) {
+            // Fall back to subnet broadcast of this interface.
+            QHostAddress broadcastAddress
+                = m_interfaceMonitor.addresses().value(address);
+            if (!broadcastAddress.isNull()) {
+                m_socket.queueDatagram(datagram, broadcastAddress,
+                                       IPMSG_DEFAULT_PORT);
+            }
+        }
     }
 }
 
-bool MsgServer::isSupportedCommand(QByteArray &datagram) const
+// Cheap when unchanged, the lists share data.
+bool MsgServer::isAddressSettingChanged() const
 {
-    QList<QByteArray> bl = datagram.split(':');
+    const Preferences *preferences = Global::preferences;
 
-    if (bl.size() < MSG_NORMAL_FIELD_COUNT) {
-        return false;
+    return m_userBroadcastIpList != preferences->userSpecifiedBroadcastIpList
+        || m_isMulticastDiscovery != preferences->isMulticastDiscovery
+        || m_multicastGroupName != preferences->multicastGroup
+        || m_multicastInterfaceList != preferences->multicastInterfaceList;
+}
+
+// Null if multicast discovery is off or the group is not a valid IPv4
+// multicast address.
+QHostAddress MsgServer::multicastGroup() const
+{
+    if (!m_isMulticastDiscovery) {
+        return QHostAddress();
     }
 
-    bool ok;
-    long command = bl.at(MSG_FLAGS_POS).toLong(&ok);
-    if (!ok) {
-        return false;
+    QHostAddress group(m_multicastGroupName);
+    if (group.protocol() != QAbstractSocket::IPv4Protocol
+            || !group.isInSubnet(QHostAddress("224.0.0.0"), 4)) {
+        qWarning("MsgServer::multicastGroup: %s is not an IPv4 multicast "
+                 "group", m_multicastGroupName.toUtf8().data());
+        return QHostAddress();
     }
 
+    return group;
+}
+
+bool MsgServer::isMulticastInterface(const QHostAddress &address) const
+{
+    return m_multicastInterfaceList.isEmpty()
+        || m_multicastInterfaceList.contains(address.toString());
+}
+
+bool MsgServer::isSupportedCommand(quint32 command) const
+{
     bool isSupport = false;
     switch (GET_MODE(command)) {
     case IPMSG_NOOPERATION:
@@ -358,9 +768,3 @@ bool MsgServer::isSupportedCommand(QByteArray &datagram) const
 
     return isSupport;
 }
-
-void MsgServer::socketEerror(QAbstractSocket::SocketError errorCode)
-{
-    emit error(errorCode, m_udpSocket.errorString());
-}
-
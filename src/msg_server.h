@@ -20,9 +20,19 @@
 #include "recv_msg.h"
 #include "send_msg.h"
 #include "msg.h"
+#include "msg_socket.h"
+#include "timer_wheel.h"
+#include "entry_responder.h"
+#include "interface_monitor.h"
 
 #include <QObject>
-#include <QUdpSocket>
+#include <QList>
+#include <QStringList>
+#include <QPair>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
+#include <QElapsedTimer>
 
 class SendMsg;
 
@@ -36,37 +46,105 @@ public:
     void start();
 
 signals:
-    void newUserMsg(Msg msg);
-    void newExitMsg(Msg msg);
-    void newMsg(Msg msg);
+    void newUserMsg(const Msg &msg);
+    void newExitMsg(const Msg &msg);
+    // A page of peers from list server.
+    void newUserList(const QList<Owner> &owners);
+    void newMsg(const Msg &msg);
     void error(QAbstractSocket::SocketError, QString errorString);
-    void releaseFile(QString additionalInfo);
+    void releaseFile(qint64 packetNo);
     void msgReaded(QString name);
+    // A msg waiting for ack is not acked after all retransmissions.
+    void sendMsgLost(const Msg &msg);
+    // A msg waiting for ack is acked by its receiver.
+    void sendMsgAcked(const Msg &msg);
+    // IPMSG_READMSG of our sealed msg, whose packet no is in additionalInfo.
+    void sendMsgReaded(const Msg &msg);
 
 public slots:
     void processSendMsg();
-    void socketEerror(QAbstractSocket::SocketError);
 
 private slots:
     void readPacket();
+    void processExpiredMsg();
+    void sendAnsEntry(const QHostAddress &address, quint16 port);
+    void updateAddresses();
+    void announceEntry();
 
 private:
     void handleMsg(Msg &msg);
-    bool isSupportedCommand(QByteArray &datagram) const;
+    bool isSupportedCommand(quint32 command) const;
     void broadcastMsg(Msg &msg);
     void broadcastUserMsg(Msg &msg);
+    void flushSendMsg();
     bool isResendNeeded(Msg &msg) const;
-    void updateAddresses();
+    bool isAckNeeded(Msg &msg) const;
+    int retransmitTimeout(Msg &msg) const;
+    void updateRtt(const QString &ip, int rtt);
+    bool isAddressSettingChanged() const;
+    QHostAddress multicastGroup() const;
+    bool isMulticastInterface(const QHostAddress &address) const;
 
-    void processRecvMsg(Msg msg);
-    void processRecvReleaseFilesMsg(Msg msg);
-    void processRecvReadMsg(Msg msg);
-    void processRecvSendMsg(Msg msg);
-    void processEntryMsg(Msg msg);
+    void processRecvMsg(const Msg &msg);
+    void processRecvReleaseFilesMsg(const Msg &msg);
+    void processRecvReadMsg(const Msg &msg);
+    void processRecvSendMsg(const Msg &msg);
+    void processEntryMsg(const Msg &msg);
+    void processRecvRecvMsg(const Msg &msg);
+    void processRecvIsGetListMsg(const Msg &msg);
+    void processRecvOkGetListMsg(const Msg &msg);
+    void processRecvGetListMsg(const Msg &msg);
+    void processRecvAnsListMsg(const Msg &msg);
+    void sendListMsg(const Msg &msg, QString additionalInfo, quint32 flags);
+    bool isOurAddress(const QHostAddress &address) const;
+    bool isDuplicateRecvMsg(const Msg &msg);
 
+    InterfaceMonitor m_interfaceMonitor;
+    // Broadcast addresses of interfaces plus those specified by user.
     QList<QHostAddress> m_broadcastAddresses;
-    QList<QHostAddress> m_ipAddresses;
-    QUdpSocket m_udpSocket;
+    QStringList m_userBroadcastIpList;
+    // Interfaces joined to m_multicastGroup, by their local ip. Presence
+    // broadcasts go to the group on these instead of subnet broadcast.
+    QHostAddress m_multicastGroup;
+    QList<QHostAddress> m_multicastInterfaces;
+    // Settings m_multicastGroup and m_multicastInterfaces came from.
+    bool m_isMulticastDiscovery;
+    QString m_multicastGroupName;
+    QStringList m_multicastInterfaceList;
+    MsgSocket m_socket;
+    // Msgs queued in m_socket and their index in the batch.
+    QList<QPair<int, Msg> > m_sendingMsgs;
+    // Msgs waiting to be sent, resent or acked. Only used in msg thread.
+    QHash<qint64, Msg> m_sendMsgMap;
+    // Retry deadlines of msgs in m_sendMsgMap.
+    TimerWheel m_timerWheel;
+    EntryResponder m_entryResponder;
+
+    // Smoothed round trip time and its variation of each peer ip, in msec.
+    struct PeerRtt {
+        int srtt;
+        int rttvar;
+    };
+    QHash<QString, PeerRtt> m_peerRtts;
+    // First send time of msgs waiting for ack, for RTT samples.
+    QHash<qint64, qint64> m_firstSendTimes;
+    QElapsedTimer m_clock;
+
+    // Recently received SENDMSGs by "ip:packetNo", oldest first in
+    // m_recentRecvMsgOrder, to drop retransmits of msgs already shown.
+    QSet<QString> m_recentRecvMsgs;
+    QQueue<QString> m_recentRecvMsgOrder;
+
+    // List server which answered our BR_ISGETLIST2, null if none yet.
+    QHostAddress m_listServer;
+    // Peer table served in ANSLIST pages to each requester ip, taken on its
+    // first page so that its later pages index the same list, dropped after
+    // HOSTLIST_SNAPSHOT_TTL.
+    struct HostList {
+        QList<Owner> owners;
+        qint64 time;
+    };
+    QHash<QString, HostList> m_hostLists;
 };
 
 #endif // !MSG_SERVER_H
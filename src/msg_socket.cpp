@@ -0,0 +1,386 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "msg_socket.h"
+#include "constants.h"
+
+#ifdef Q_OS_LINUX
+
+#include <QSocketNotifier>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+#define MSG_SOCKET_BATCH_SIZE       16
+#define MSG_SOCKET_DATAGRAM_SIZE    65536
+// Room for a login storm while message thread is busy.
+#define MSG_SOCKET_RECV_BUFFER_SIZE (1024*1024)
+
+MsgSocket::MsgSocket(QObject *parent)
+    : QObject(parent), m_fd(-1), m_notifier(0)
+{
+}
+
+MsgSocket::~MsgSocket()
+{
+    if (m_fd != -1) {
+        close(m_fd);
+    }
+}
+
+bool MsgSocket::bind(quint16 port)
+{
+    m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd == -1) {
+        m_errorString = strerror(errno);
+        emit error(QAbstractSocket::UnknownSocketError, m_errorString);
+        return false;
+    }
+
+    int on = 1;
+    setsockopt(m_fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    int size = MSG_SOCKET_RECV_BUFFER_SIZE;
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    int ttl = MULTICAST_TTL;
+    setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (::bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        int err = errno;
+        m_errorString = strerror(err);
+        close(m_fd);
+        m_fd = -1;
+        emit error(err == EADDRINUSE ? QAbstractSocket::AddressInUseError
+                   : QAbstractSocket::UnknownSocketError, m_errorString);
+        return false;
+    }
+
+    m_recvBuffer.resize(MSG_SOCKET_BATCH_SIZE * MSG_SOCKET_DATAGRAM_SIZE);
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, SIGNAL(activated(int)), this, SIGNAL(readyRead()));
+
+    return true;
+}
+
+int MsgSocket::readDatagrams(QList<Datagram> &datagrams)
+{
+    if (m_fd == -1) {
+        return 0;
+    }
+
+    struct mmsghdr msgs[MSG_SOCKET_BATCH_SIZE];
+    struct iovec iovecs[MSG_SOCKET_BATCH_SIZE];
+    struct sockaddr_in addrs[MSG_SOCKET_BATCH_SIZE];
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < MSG_SOCKET_BATCH_SIZE; ++i) {
+        iovecs[i].iov_base = m_recvBuffer.data() + i * MSG_SOCKET_DATAGRAM_SIZE;
+        iovecs[i].iov_len = MSG_SOCKET_DATAGRAM_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    int n;
+    do {
+        n = recvmmsg(m_fd, msgs, MSG_SOCKET_BATCH_SIZE, MSG_DONTWAIT, 0);
+    } while (n == -1 && errno == EINTR);
+    if (n <= 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            continue;
+        }
+
+        Datagram datagram;
+        datagram.data = QByteArray((const char *)iovecs[i].iov_base,
+                                   msgs[i].msg_len);
+        datagram.address.setAddress(ntohl(addrs[i].sin_addr.s_addr));
+        datagram.port = ntohs(addrs[i].sin_port);
+        datagrams << datagram;
+    }
+
+    return n;
+}
+
+void MsgSocket::flush(QVector<bool> &results)
+{
+    // Only datagrams sendmmsg() reports as sent are marked ok.
+    results.fill(false, m_sendQueue.size());
+
+    int begin = 0;
+    while (begin < m_sendQueue.size()) {
+        int count = qMin(m_sendQueue.size() - begin, MSG_SOCKET_BATCH_SIZE);
+
+        struct mmsghdr msgs[MSG_SOCKET_BATCH_SIZE];
+        struct iovec iovecs[MSG_SOCKET_BATCH_SIZE];
+        struct sockaddr_in addrs[MSG_SOCKET_BATCH_SIZE];
+
+        memset(msgs, 0, sizeof(msgs));
+        memset(addrs, 0, sizeof(addrs));
+        for (int i = 0; i < count; ++i) {
+            const Datagram &datagram = m_sendQueue.at(begin + i);
+            iovecs[i].iov_base = (void *)datagram.data.constData();
+            iovecs[i].iov_len = datagram.data.size();
+            addrs[i].sin_family = AF_INET;
+            addrs[i].sin_addr.s_addr = htonl(datagram.address.toIPv4Address());
+            addrs[i].sin_port = htons(datagram.port);
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        int n;
+        do {
+            n = sendmmsg(m_fd, msgs, count, 0);
+        } while (n == -1 && errno == EINTR);
+
+        if (n <= 0) {
+            int err = (n == 0) ? EAGAIN : errno;
+            m_errorString = strerror(err);
+            if (err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS
+                || err == ENOMEM) {
+                // Socket is full, the rest would fail too, all of them are
+                // left failed and retried by caller.
+                break;
+            }
+            // XXX NOTE: sendmmsg() only reports error of the first message,
+            // it is left failed, and we go on with the rest so that one bad
+            // address does not fail them.
+            n = 1;
+        } else {
+            for (int i = 0; i < n; ++i) {
+                results[begin + i] = true;
+            }
+        }
+        begin += n;
+    }
+
+    m_sendQueue.clear();
+}
+
+static bool setMembership(int fd, int option, const QHostAddress &group,
+                          const QHostAddress &interfaceAddress)
+{
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = htonl(group.toIPv4Address());
+    mreq.imr_interface.s_addr = htonl(interfaceAddress.toIPv4Address());
+
+    return setsockopt(fd, IPPROTO_IP, option, &mreq, sizeof(mreq)) == 0;
+}
+
+bool MsgSocket::joinMulticastGroup(const QHostAddress &group,
+                                   const QHostAddress &interfaceAddress)
+{
+    if (m_fd == -1) {
+        return false;
+    }
+
+    if (!setMembership(m_fd, IP_ADD_MEMBERSHIP, group, interfaceAddress)) {
+        m_errorString = strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+void MsgSocket::leaveMulticastGroup(const QHostAddress &group,
+                                    const QHostAddress &interfaceAddress)
+{
+    if (m_fd != -1) {
+        setMembership(m_fd, IP_DROP_MEMBERSHIP, group, interfaceAddress);
+    }
+}
+
+bool MsgSocket::sendMulticast(const QByteArray &data,
+                              const QHostAddress &group, quint16 port,
+                              const QHostAddress &interfaceAddress)
+{
+    if (m_fd == -1) {
+        return false;
+    }
+
+    struct in_addr interface;
+    interface.s_addr = htonl(interfaceAddress.toIPv4Address());
+    setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_IF,
+               &interface, sizeof(interface));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(group.toIPv4Address());
+    addr.sin_port = htons(port);
+
+    ssize_t n;
+    do {
+        n = sendto(m_fd, data.constData(), data.size(), 0,
+                   (struct sockaddr *)&addr, sizeof(addr));
+    } while (n == -1 && errno == EINTR);
+    if (n == -1) {
+        m_errorString = strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+void MsgSocket::socketError(QAbstractSocket::SocketError errorCode)
+{
+    emit error(errorCode, m_errorString);
+}
+
+#else // !Q_OS_LINUX
+
+#include <QNetworkInterface>
+
+MsgSocket::MsgSocket(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_udpSocket, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+    connect(&m_udpSocket, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(socketError(QAbstractSocket::SocketError)));
+}
+
+MsgSocket::~MsgSocket()
+{
+}
+
+bool MsgSocket::bind(quint16 port)
+{
+    // XXX NOTE: IPv4 multicast groups can't be joined on a dual stack
+    // socket.
+    if (!m_udpSocket.bind(QHostAddress::AnyIPv4, port)) {
+        return false;
+    }
+
+    m_udpSocket.setSocketOption(QAbstractSocket::MulticastTtlOption,
+                                MULTICAST_TTL);
+    return true;
+}
+
+int MsgSocket::readDatagrams(QList<Datagram> &datagrams)
+{
+    int n = 0;
+    while (m_udpSocket.hasPendingDatagrams()) {
+        Datagram datagram;
+        datagram.data.resize(m_udpSocket.pendingDatagramSize());
+        if (m_udpSocket.readDatagram(datagram.data.data(),
+                                     datagram.data.size(),
+                                     &datagram.address,
+                                     &datagram.port) == -1) {
+            continue;
+        }
+        datagrams << datagram;
+        ++n;
+    }
+
+    return n;
+}
+
+void MsgSocket::flush(QVector<bool> &results)
+{
+    results.fill(true, m_sendQueue.size());
+
+    for (int i = 0; i < m_sendQueue.size(); ++i) {
+        const Datagram &datagram = m_sendQueue.at(i);
+        if (m_udpSocket.writeDatagram(datagram.data, datagram.address,
+                                      datagram.port) == -1) {
+            m_errorString = m_udpSocket.errorString();
+            results[i] = false;
+        }
+    }
+
+    m_sendQueue.clear();
+}
+
+static QNetworkInterface interfaceOf(const QHostAddress &address)
+{
+    foreach (QNetworkInterface interface, QNetworkInterface::allInterfaces()) {
+        foreach (QNetworkAddressEntry entry, interface.addressEntries()) {
+            if (entry.ip() == address) {
+                return interface;
+            }
+        }
+    }
+
+    return QNetworkInterface();
+}
+
+bool MsgSocket::joinMulticastGroup(const QHostAddress &group,
+                                   const QHostAddress &interfaceAddress)
+{
+    if (!m_udpSocket.joinMulticastGroup(group,
+                                        interfaceOf(interfaceAddress))) {
+        m_errorString = m_udpSocket.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void MsgSocket::leaveMulticastGroup(const QHostAddress &group,
+                                    const QHostAddress &interfaceAddress)
+{
+    m_udpSocket.leaveMulticastGroup(group, interfaceOf(interfaceAddress));
+}
+
+bool MsgSocket::sendMulticast(const QByteArray &data,
+                              const QHostAddress &group, quint16 port,
+                              const QHostAddress &interfaceAddress)
+{
+    m_udpSocket.setMulticastInterface(interfaceOf(interfaceAddress));
+    if (m_udpSocket.writeDatagram(data, group, port) == -1) {
+        m_errorString = m_udpSocket.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void MsgSocket::socketError(QAbstractSocket::SocketError errorCode)
+{
+    m_errorString = m_udpSocket.errorString();
+    emit error(errorCode, m_errorString);
+}
+
+#endif // Q_OS_LINUX
+
+int MsgSocket::queueDatagram(const QByteArray &data,
+                             const QHostAddress &address, quint16 port)
+{
+    Datagram datagram;
+    datagram.data = data;
+    datagram.address = address;
+    datagram.port = port;
+    m_sendQueue << datagram;
+
+    return m_sendQueue.size() - 1;
+}
@@ -0,0 +1,97 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef MSG_SOCKET_H
+#define MSG_SOCKET_H
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QAbstractSocket>
+
+#ifdef Q_OS_LINUX
+class QSocketNotifier;
+#else
+#include <QUdpSocket>
+#endif
+
+// UDP socket of MsgServer. On Linux datagrams are received and sent in
+// batches with recvmmsg()/sendmmsg(), so a burst of packets costs a few
+// system calls instead of one per packet. Other platforms use QUdpSocket.
+class MsgSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Datagram {
+        QByteArray data;
+        QHostAddress address;
+        quint16 port;
+    };
+
+    MsgSocket(QObject *parent = 0);
+    ~MsgSocket();
+
+    bool bind(quint16 port);
+
+    // Append at most one batch of pending datagrams to 'datagrams', return
+    // number of datagrams read, 0 if none is pending.
+    int readDatagrams(QList<Datagram> &datagrams);
+
+    // Queue a datagram to be sent by flush(), return its index in 'results'
+    // of flush().
+    int queueDatagram(const QByteArray &data, const QHostAddress &address,
+                      quint16 port);
+
+    // Send all queued datagrams, results[i] is false if i-th one failed.
+    void flush(QVector<bool> &results);
+
+    // IPv4 multicast group membership on the interface with local address
+    // 'interfaceAddress'.
+    bool joinMulticastGroup(const QHostAddress &group,
+                            const QHostAddress &interfaceAddress);
+    void leaveMulticastGroup(const QHostAddress &group,
+                             const QHostAddress &interfaceAddress);
+
+    // Send to 'group' out of the given interface at once, not queued.
+    bool sendMulticast(const QByteArray &data, const QHostAddress &group,
+                       quint16 port, const QHostAddress &interfaceAddress);
+
+    QString errorString() const { return m_errorString; }
+
+signals:
+    void readyRead();
+    void error(QAbstractSocket::SocketError, QString errorString);
+
+private slots:
+    void socketError(QAbstractSocket::SocketError);
+
+private:
+#ifdef Q_OS_LINUX
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QByteArray m_recvBuffer;
+#else
+    QUdpSocket m_udpSocket;
+#endif
+
+    QList<Datagram> m_sendQueue;
+    QString m_errorString;
+};
+
+#endif // !MSG_SOCKET_H
@@ -20,16 +20,18 @@
 #include "global.h"
 #include "send_msg.h"
 #include "recv_msg.h"
-#include "window_manager.h"
 #include "user_manager.h"
 
-#include <QTimer>
-#include <QMessageBox>
-
 
 MsgThread::~MsgThread()
 {
-    m_msgServer->processSendMsg();
+    // Send last msgs like IPMSG_BR_EXIT in msg thread, which owns socket.
+    // Only if its event loop runs, or we would wait for ever.
+    MsgServer *msgServer = m_msgServer.loadAcquire();
+    if (msgServer && isRunning()) {
+        QMetaObject::invokeMethod(msgServer, "processSendMsg",
+                                  Qt::BlockingQueuedConnection);
+    }
 
     exit(0);
     wait();
@@ -37,46 +39,46 @@ MsgThread::~MsgThread()
 
 void MsgThread::run()
 {
-    QTimer timer;
-    timer.start(SEND_MSG_PROCESS_INTERVAL);
-
-    m_msgServer = new MsgServer;
-
-    connect(&timer, SIGNAL(timeout()),
-            m_msgServer, SLOT(processSendMsg()));
-
-    connect(m_msgServer, SIGNAL(newMsg(Msg)),
-            Global::windowManager, SLOT(newMsg(Msg)));
-    connect(m_msgServer, SIGNAL(newUserMsg(Msg)),
+    MsgServer *msgServer = new MsgServer;
+
+    connect(msgServer, SIGNAL(newMsg(Msg)),
+            this, SIGNAL(newMsg(Msg)));
+    connect(msgServer, SIGNAL(sendMsgLost(Msg)),
+            this, SIGNAL(sendMsgLost(Msg)));
+    connect(msgServer, SIGNAL(sendMsgAcked(Msg)),
+            this, SIGNAL(sendMsgAcked(Msg)));
+    connect(msgServer, SIGNAL(sendMsgReaded(Msg)),
+            this, SIGNAL(sendMsgReaded(Msg)));
+    connect(msgServer, SIGNAL(newUserMsg(Msg)),
             Global::userManager, SLOT(newUserMsg(Msg)));
-    connect(m_msgServer, SIGNAL(newExitMsg(Msg)),
+    connect(msgServer, SIGNAL(newExitMsg(Msg)),
             Global::userManager, SLOT(newExitMsg(Msg)));
+    connect(msgServer, SIGNAL(newUserList(QList<Owner>)),
+            Global::userManager, SLOT(newUserList(QList<Owner>)));
 
-    connect(m_msgServer, SIGNAL(error(QAbstractSocket::SocketError, QString)),
+    connect(msgServer, SIGNAL(error(QAbstractSocket::SocketError, QString)),
             this, SLOT(handleError(QAbstractSocket::SocketError, QString)));
 
-    m_msgServer->start();
-
-    exec();
-}
-
-void MsgThread::addSendMsg(Msg msg)
-{
-    QMutexLocker locker(&m_lock);
-
-    m_sendMsgMap.insert(msg->packetNoString(), msg);
-}
+    msgServer->start();
 
-void MsgThread::removeSendMsg(QString packetNoString)
-{
-    QMutexLocker locker(&m_lock);
+    // XXX NOTE: publish server before draining queue, a msg pushed to empty
+    // queue before that finds no server to wake, but is drained here.
+    m_msgServer.storeRelease(msgServer);
+    msgServer->processSendMsg();
 
-    m_sendMsgMap.remove(packetNoString);
+    exec();
 }
 
-void MsgThread::removeSendMsgNotLock(QString packetNoString)
+void MsgThread::addSendMsg(const Msg &msg)
 {
-    m_sendMsgMap.remove(packetNoString);
+    // Wake msg server once for all msgs added until it runs.
+    if (m_newSendMsgs.push(msg)) {
+        MsgServer *msgServer = m_msgServer.loadAcquire();
+        if (msgServer) {
+            QMetaObject::invokeMethod(msgServer, "processSendMsg",
+                                      Qt::QueuedConnection);
+        }
+    }
 }
 
 void MsgThread::handleError(QAbstractSocket::SocketError errorCode, QString s)
@@ -85,13 +87,14 @@ void MsgThread::handleError(QAbstractSocket::SocketError errorCode, QString s)
 
     QString errorString(QObject::tr("udp server error"));
 
-    QMessageBox::critical(0, QObject::tr("QIpMsg"),
-                          errorString + ":\n" + s + ".");
-
-    qDebug() << "MsgThread::handleError:" << s;
+    qWarning() << "MsgThread::handleError:" << s;
 
+    // Front end reports it and decides how to quit.
     if (errorCode == QAbstractSocket::AddressInUseError) {
-        ::exit(-1);
+        m_isFatalError = true;
+        emit fatalError(errorString + ":\n" + s + ".");
+    } else {
+        emit error(errorString + ":\n" + s + ".");
     }
 }
 
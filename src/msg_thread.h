@@ -18,9 +18,10 @@
 #define MSG_THREAD_H
 
 #include "msg.h"
+#include "mpsc_queue.h"
 
 #include <QThread>
-#include <QMutex>
+#include <QAtomicPointer>
 
 class MsgServer;
 
@@ -30,28 +31,39 @@ class MsgThread : public QThread
 
 public:
     friend class MsgServer;
-    MsgThread(QObject *parent = 0) :QThread(parent) {}
+    MsgThread(QObject *parent = 0) : QThread(parent), m_isFatalError(false) {}
     ~MsgThread();
 
     virtual void run();
 
-    void addSendMsg(Msg msg);
-    void addSendMsgNotLock(Msg msg);
-    void removeSendMsg(QString packetNo);
-    void removeSendMsgNotLock(QString packetNo);
+    // Queue msg to send, may be called in any thread and never blocks.
+    void addSendMsg(const Msg &msg);
+
+    // Whether fatalError() was emitted, front end should exit with error.
+    bool hasFatalError() const { return m_isFatalError; }
 
 private slots:
     void handleError(QAbstractSocket::SocketError errorCode, QString s);
 
 signals:
-    void newMsg(Msg msg);
-    void newUserMsg(Msg msg);
+    // Forwarded from MsgServer, so that no front end is known here.
+    void newMsg(const Msg &msg);
+    void newUserMsg(const Msg &msg);
+    void sendMsgLost(const Msg &msg);
+    void sendMsgAcked(const Msg &msg);
+    void sendMsgReaded(const Msg &msg);
+    void error(QString errorString);
+    // Msgs can not be sent or received at all, e.g. port is in use. Front
+    // end reports it and quits.
+    void fatalError(QString errorString);
 
 private:
-    QMutex m_lock;
-    QMap<QString, Msg> m_sendMsgMap;
+    // Msgs added since MsgServer last processed, msgs waiting to be resent
+    // or acked are owned by MsgServer.
+    MpscQueue<Msg> m_newSendMsgs;
 
-    MsgServer *m_msgServer;
+    QAtomicPointer<MsgServer> m_msgServer;
+    bool m_isFatalError;
 };
 
 #endif // !MSG_THREAD_H
@@ -584,7 +584,12 @@ void MsgWindow::retryRecvFile()
 
 void MsgWindow::updateTransferStatsInfo()
 {
-    fileInfoButton
-        ->setText(m_recvFileMap.currentFile()->transferStatsInfo());
+    // Show total stats when receive several files in parallel.
+    if (m_recvFileMap.activeCount() > 1) {
+        fileInfoButton->setText(m_recvFileMap.transferStatsInfo());
+    } else {
+        fileInfoButton
+            ->setText(m_recvFileMap.currentFile()->transferStatsInfo());
+    }
 }
 
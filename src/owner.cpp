@@ -16,13 +16,14 @@
 
 #include "owner.h"
 #include "constants.h"
+#include "packet_parser.h"
+#include "global.h"
+#include "transfer_codec.h"
 
-#include <QStringList>
-
-Owner::Owner(QString packet, QHostAddress address, quint16 port)
+Owner::Owner(const PacketParser &parser, QHostAddress address, quint16 port)
     : m_ipAddress(address), m_port(port)
 {
-    initOwner(packet);
+    initOwner(parser);
 }
 
 #if 0
@@ -55,20 +56,17 @@ Owner& Owner::operator=(const Owner &rhs)
 }
 #endif
 
-void Owner::initOwner(QString &packet)
+void Owner::initOwner(const PacketParser &parser)
 {
-    QStringList list = packet.split(COMMAND_SEPERATOR);
-
-    if (list.size() < MSG_NORMAL_FIELD_COUNT) {
-        return;
-    }
+    QTextCodec *codec = Global::transferCodec->codec();
 
-    m_loginName = list.at(MSG_LOG_NAME_POS);
+    m_loginName = parser.toString(PacketParser::LoginName, codec);
 
-    quint32 flag = list.at(MSG_FLAGS_POS).toUInt();
+    quint32 flag = parser.flags();
     if (flag & IPMSG_BR_ENTRY || flag & IPMSG_BR_ABSENCE) {
-        m_group = packet.section(QChar(EXTEND_INFO_SEPERATOR), 1, 1);
-        m_name = parseAdditionalInfo(packet);
+        // Group name, and user name or absence string
+        m_group = parser.toString(PacketParser::ExtendedInfo, codec);
+        m_name = parser.toString(PacketParser::AdditionalInfo, codec);
         if (m_name.isEmpty()) {
             m_name = m_loginName;
         }
@@ -80,24 +78,5 @@ void Owner::initOwner(QString &packet)
         m_name = m_loginName;
     }
 
-    m_host = list.at(MSG_HOST_POS);
+    m_host = parser.toString(PacketParser::Host, codec);
 }
-
-QString Owner::parseAdditionalInfo(QString &packet)
-{
-    int cnt = 0;
-    int index = 0;
-    while (cnt < MSG_ADDITION_INFO_POS) {
-        int id = packet.indexOf(QChar(COMMAND_SEPERATOR), index);
-        if (index == -1) {
-            break;
-        }
-        ++cnt;
-        index = id + 1;
-    }
-
-    QString s = packet.right(packet.size() - index);
-
-    return s.section(QChar(EXTEND_INFO_SEPERATOR), 0, 0);
-}
-
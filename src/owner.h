@@ -18,13 +18,15 @@
 #define OWNER_H
 
 #include <QHostAddress>
+#include <QMetaType>
 
+class PacketParser;
 
 class Owner
 {
 public:
-    Owner() {}
-    Owner(QString packet, QHostAddress address, quint16 port);
+    Owner() : m_port(0) {}
+    Owner(const PacketParser &parser, QHostAddress address, quint16 port);
 #if 0
     Owner(const Owner &rhs);
     Owner& operator=(const Owner &rhs);
@@ -42,17 +44,20 @@ public:
     void setHost(QString host) { m_host = host; }
     QString host() const { return m_host; }
 
+    void setIpAddress(QHostAddress address) { m_ipAddress = address; }
+    QHostAddress ipAddress() const { return m_ipAddress; }
     QString ip() const { return m_ipAddress.toString(); }
 
+    void setPort(quint16 port) { m_port = port; }
+    quint16 port() const { return m_port; }
+
     void setDisplayLevel(QString displayLevel) {
         m_displayLevel = displayLevel;
     }
     QString displayLevel() const { return m_displayLevel; }
 
 private:
-    // Get group name or absence string
-    QString parseAdditionalInfo(QString &packet);
-    void initOwner(QString &packet);
+    void initOwner(const PacketParser &parser);
 
     QString m_name;
     QString m_loginName;
@@ -63,5 +68,7 @@ private:
     QString m_displayLevel;
 };
 
+Q_DECLARE_METATYPE(Owner)
+
 #endif // !OWNER_H
 
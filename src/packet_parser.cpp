@@ -0,0 +1,101 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "packet_parser.h"
+#include "constants.h"
+
+#include <QTextCodec>
+
+#include <string.h>
+
+bool PacketParser::parse(const char *data, int size)
+{
+    m_data = data;
+
+    // Fields before additionalInfo are separated by ':'.
+    int begin = 0;
+    for (int i = Version; i < AdditionalInfo; ++i) {
+        const char *sep = (const char *)memchr(data + begin, COMMAND_SEPERATOR,
+                                               size - begin);
+        if (sep == 0) {
+            return false;
+        }
+        m_fields[i].begin = begin;
+        m_fields[i].size = sep - (data + begin);
+        begin = sep - data + 1;
+    }
+
+    // additionalInfo and extendedInfo are terminated by '\0' or end of
+    // packet.
+    for (int i = AdditionalInfo; i < FieldCount; ++i) {
+        m_fields[i].begin = begin;
+        const char *end = (const char *)memchr(data + begin,
+                                               EXTEND_INFO_SEPERATOR,
+                                               size - begin);
+        if (end == 0) {
+            m_fields[i].size = size - begin;
+            begin = size;
+        } else {
+            m_fields[i].size = end - (data + begin);
+            begin = end - data + 1;
+        }
+    }
+
+    // flags must be a decimal number
+    const View &flags = m_fields[Flags];
+    if (flags.size == 0 || flags.size > 10) {
+        return false;
+    }
+    quint64 n = 0;
+    for (int i = flags.begin; i < flags.begin + flags.size; ++i) {
+        if (data[i] < '0' || data[i] > '9') {
+            return false;
+        }
+        n = n * 10 + (data[i] - '0');
+    }
+    if (n > 0xffffffffULL) {
+        return false;
+    }
+    m_flags = n;
+
+    return true;
+}
+
+qint64 PacketParser::toLongLong(Fields field) const
+{
+    const char *data = fieldData(field);
+    int size = fieldSize(field);
+
+    // Up to 18 digits always fit in qint64, longer ones are not ours.
+    if (size > 18) {
+        return 0;
+    }
+
+    qint64 n = 0;
+    for (int i = 0; i < size; ++i) {
+        if (data[i] < '0' || data[i] > '9') {
+            return 0;
+        }
+        n = n * 10 + (data[i] - '0');
+    }
+
+    return n;
+}
+
+QString PacketParser::toString(Fields field, QTextCodec *codec) const
+{
+    return codec->toUnicode(fieldData(field), fieldSize(field));
+}
@@ -0,0 +1,69 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PACKET_PARSER_H
+#define PACKET_PARSER_H
+
+#include <QString>
+#include <QtGlobal>
+
+class QTextCodec;
+
+// Single pass parser of a raw IPMSG packet
+// "version:packetNo:loginName:host:flags:additionalInfo\0extendedInfo\0".
+// Fields are views into the datagram, nothing is copied or allocated until
+// a field is converted with toString().
+//
+// XXX NOTE: ':' and '\0' never appear as trail byte of supported multibyte
+// encodings (GBK, Big5, Shift_JIS, UTF-8), so we can split before decoding.
+class PacketParser
+{
+public:
+    enum Fields {
+        Version = 0, PacketNo, LoginName, Host, Flags, AdditionalInfo,
+        ExtendedInfo, FieldCount
+    };
+
+    PacketParser() : m_data(0), m_flags(0) {}
+
+    // 'data' must live as long as fields are used. Return false if it is not
+    // a valid packet.
+    bool parse(const char *data, int size);
+
+    quint32 flags() const { return m_flags; }
+
+    const char *fieldData(Fields field) const {
+        return m_data + m_fields[field].begin;
+    }
+    int fieldSize(Fields field) const { return m_fields[field].size; }
+
+    QString toString(Fields field, QTextCodec *codec) const;
+    // Decimal field like packet number, 0 if it is not a number of at most
+    // 18 digits. Use the field text when it must be echoed to the peer.
+    qint64 toLongLong(Fields field) const;
+
+private:
+    struct View {
+        int begin;
+        int size;
+    };
+
+    const char *m_data;
+    View m_fields[FieldCount];
+    quint32 m_flags;
+};
+
+#endif // !PACKET_PARSER_H
@@ -15,7 +15,7 @@
 //
 
 #include <QSettings>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QtDebug>
 #include <QDir>
 
@@ -78,6 +78,17 @@ void Preferences::reset()
     // End internel use
 
     transferCodecName = "GB2312";
+    maxSendFileThreadCount = 8;
+    isEventDrivenFileServer = false;
+    fileServerEventLoopCount = 2;
+    maxRecvFileConnectionCount = 1;
+    recvFileSegmentCount = 1;
+
+    isMulticastDiscovery = false;
+    multicastGroup = MULTICAST_DEFAULT_GROUP;
+    multicastInterfaceList.clear();
+
+    isListServer = false;
 }
 
 void Preferences::load()
@@ -152,6 +163,29 @@ void Preferences::load()
     set->beginGroup("Transfer");
     transferCodecName
         = set->value("transferCodecName", transferCodecName).toString();
+    maxSendFileThreadCount = set->value("maxSendFileThreadCount",
+            maxSendFileThreadCount).toInt();
+    isEventDrivenFileServer = set->value("isEventDrivenFileServer",
+            isEventDrivenFileServer).toBool();
+    fileServerEventLoopCount = set->value("fileServerEventLoopCount",
+            fileServerEventLoopCount).toInt();
+    maxRecvFileConnectionCount = set->value("maxRecvFileConnectionCount",
+            maxRecvFileConnectionCount).toInt();
+    recvFileSegmentCount = set->value("recvFileSegmentCount",
+            recvFileSegmentCount).toInt();
+    set->endGroup();
+
+    set->beginGroup("Multicast");
+    isMulticastDiscovery = set->value("isMulticastDiscovery",
+            isMulticastDiscovery).toBool();
+    multicastGroup = set->value("multicastGroup", multicastGroup).toString();
+    multicastInterfaceList = set->value("multicastInterface",
+            multicastInterfaceList.join("\r")).toString()
+        .split(QChar('\r'), QString::SkipEmptyParts);
+    set->endGroup();
+
+    set->beginGroup("ListServer");
+    isListServer = set->value("isListServer", isListServer).toBool();
     set->endGroup();
 
 }
@@ -214,6 +248,21 @@ void Preferences::save()
 
     set->beginGroup("Transfer");
     set->setValue("transferCodecName", transferCodecName);
+    set->setValue("maxSendFileThreadCount", maxSendFileThreadCount);
+    set->setValue("isEventDrivenFileServer", isEventDrivenFileServer);
+    set->setValue("fileServerEventLoopCount", fileServerEventLoopCount);
+    set->setValue("maxRecvFileConnectionCount", maxRecvFileConnectionCount);
+    set->setValue("recvFileSegmentCount", recvFileSegmentCount);
+    set->endGroup();
+
+    set->beginGroup("Multicast");
+    set->setValue("isMulticastDiscovery", isMulticastDiscovery);
+    set->setValue("multicastGroup", multicastGroup);
+    set->setValue("multicastInterface", multicastInterfaceList.join("\r"));
+    set->endGroup();
+
+    set->beginGroup("ListServer");
+    set->setValue("isListServer", isListServer);
     set->endGroup();
 }
 
@@ -69,9 +69,22 @@ public:
     bool isSearchAllColumns;
 
     QString transferCodecName;
+    int maxSendFileThreadCount;
+    bool isEventDrivenFileServer;
+    int fileServerEventLoopCount;
+    int maxRecvFileConnectionCount;
+    int recvFileSegmentCount;
 
     QStringList userSpecifiedBroadcastIpList;
     QString userSpecifiedBroadcastIp;
+
+    bool isMulticastDiscovery;
+    QString multicastGroup;
+    // Local ips of interfaces using multicast, empty for all.
+    QStringList multicastInterfaceList;
+
+    // Answer GETLIST with our peer table.
+    bool isListServer;
 };
 
 #endif // !PREFERENCES_H
@@ -0,0 +1,128 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "presence_cache.h"
+#include "constants.h"
+#include "helper.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+
+#include <algorithm>
+
+#define PRESENCE_CACHE_MAGIC        0x51504331  // "QPC1"
+#define PRESENCE_CACHE_VERSION      1
+
+static bool recentFirst(const PresenceCache::Entry &a,
+                        const PresenceCache::Entry &b)
+{
+    return a.lastSeen > b.lastSeen;
+}
+
+QString PresenceCache::fileName()
+{
+    return Helper::appHomePath() + "/presence.cache";
+}
+
+QList<PresenceCache::Entry> PresenceCache::load(qint64 now)
+{
+    QList<Entry> entries;
+
+    QFile file(fileName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return entries;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    qint32 version;
+    quint32 count;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != PRESENCE_CACHE_MAGIC
+            || version != PRESENCE_CACHE_VERSION) {
+        qDebug("PresenceCache::load: ignore invalid %s",
+               fileName().toUtf8().data());
+        return entries;
+    }
+
+    count = qMin(count, quint32(PRESENCE_CACHE_MAX_PEERS));
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 ip;
+        quint16 port;
+        qint64 lastSeen;
+        QString name, group, host, loginName, displayLevel;
+        in >> ip >> port >> lastSeen
+            >> name >> group >> host >> loginName >> displayLevel;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+
+        if (now - lastSeen > PRESENCE_CACHE_MAX_AGE || ip == 0) {
+            continue;
+        }
+
+        Entry entry;
+        entry.owner.setIpAddress(QHostAddress(ip));
+        entry.owner.setPort(port);
+        entry.owner.setName(name);
+        entry.owner.setGroup(group);
+        entry.owner.setHost(host);
+        entry.owner.setLoginName(loginName);
+        entry.owner.setDisplayLevel(displayLevel);
+        entry.lastSeen = lastSeen;
+        entries.append(entry);
+    }
+
+    return entries;
+}
+
+bool PresenceCache::save(QList<Entry> entries, qint64 now)
+{
+    std::sort(entries.begin(), entries.end(), recentFirst);
+
+    while (!entries.isEmpty()
+            && (entries.size() > PRESENCE_CACHE_MAX_PEERS
+                || now - entries.last().lastSeen > PRESENCE_CACHE_MAX_AGE)) {
+        entries.removeLast();
+    }
+
+    // Write to a temporary file and rename, so a crash never leaves a
+    // truncated cache behind.
+    QSaveFile file(fileName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning("PresenceCache::save: can't open %s",
+                 fileName().toUtf8().data());
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << quint32(PRESENCE_CACHE_MAGIC) << qint32(PRESENCE_CACHE_VERSION)
+        << quint32(entries.size());
+    foreach (const Entry &entry, entries) {
+        out << entry.owner.ipAddress().toIPv4Address()
+            << entry.owner.port() << entry.lastSeen
+            << entry.owner.name() << entry.owner.group()
+            << entry.owner.host() << entry.owner.loginName()
+            << entry.owner.displayLevel();
+    }
+
+    return file.commit();
+}
@@ -0,0 +1,45 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PRESENCE_CACHE_H
+#define PRESENCE_CACHE_H
+
+#include "owner.h"
+
+#include <QList>
+#include <QString>
+
+// Peers seen online in previous runs, kept in a small binary file under
+// Helper::appHomePath(), so the user list is filled at startup before any
+// ANSENTRY reply arrives.
+class PresenceCache
+{
+public:
+    struct Entry {
+        Owner owner;
+        qint64 lastSeen;    // msecs since epoch
+    };
+
+    static QString fileName();
+
+    // Entries older than PRESENCE_CACHE_MAX_AGE are dropped.
+    static QList<Entry> load(qint64 now);
+
+    // Only the PRESENCE_CACHE_MAX_PEERS most recently seen are kept.
+    static bool save(QList<Entry> entries, qint64 now);
+};
+
+#endif // !PRESENCE_CACHE_H
@@ -28,6 +28,7 @@
 #include "recv_msg.h"
 #include "send_msg.h"
 #include "send_file_manager.h"
+#include "control_server.h"
 
 QIpMsg::QIpMsg(QObject *parent)
     : QObject(parent)
@@ -36,11 +37,18 @@ QIpMsg::QIpMsg(QObject *parent)
 
     createConnections();
 
+    // Scripts drive the running instance through it, see ControlServer.
+    m_controlServer = new ControlServer(this);
+    m_controlServer->listen();
+
     Global::systray->show();
 }
 
 QIpMsg::~QIpMsg()
 {
+    // Connected to global objects, so go first.
+    delete m_controlServer;
+
     // delete global variable and save settings.
     Global::globalEnd();
 }
@@ -19,6 +19,8 @@
 
 #include <QObject>
 
+class ControlServer;
+
 class QIpMsg : public QObject
 {
     Q_OBJECT
@@ -32,6 +34,8 @@ public:
 
 private:
     void createConnections();
+
+    ControlServer *m_controlServer;
 };
 
 #endif // !QIPMSG_H
@@ -10,9 +10,14 @@ RESOURCES = icons.qrc
 HEADERS += \
 	about_dialog.h \
 	msg_server.h \
+	msg_socket.h \
+	mpsc_queue.h \
 	constants.h \
 	version.h \
 	dir_dialog.h \
+	dir_walker.h \
+	control_server.h \
+	entry_responder.h \
 	recv_file_finish_dialog.h \
 	global.h \
 	helper.h \
@@ -36,15 +41,18 @@ HEADERS += \
 	recv_file_model.h \
 	recv_file_map.h \
 	recv_file_transfer.h \
+	recv_file_writer.h \
 	recv_file_thread.h \
 	recvfilesortfilterproxymodel.h \
 	retry_recv_file_dialog.h \
 	recv_file_window.h \
 	send_file_model.h \
 	send_file_map.h \
+	send_file_set.h \
 	send_file.h \
-	send_file_handle.h \
 	send_file_thread.h \
+	send_file_thread_pool.h \
+	send_file_event_loop.h \
 	send_file_window.h \
 	send_file_manager.h \
 	serve_socket.h \
@@ -52,9 +60,13 @@ HEADERS += \
 	sizecolumndelegate.h \
 	systray.h \
 	file_server.h \
+	interface_monitor.h \
 	transfer_codec.h \
+	timer_wheel.h \
 	translator.h \
 	owner.h \
+	packet_parser.h \
+	presence_cache.h \
 	sound.h \
 	sound_thread.h \
 	user_manager.h \
@@ -65,7 +77,11 @@ HEADERS += \
 SOURCES += \
 	about_dialog.cpp \
 	msg_server.cpp \
+	msg_socket.cpp \
 	dir_dialog.cpp \
+	dir_walker.cpp \
+	control_server.cpp \
+	entry_responder.cpp \
 	recv_file_finish_dialog.cpp \
 	global.cpp \
 	helper.cpp \
@@ -89,15 +105,18 @@ SOURCES += \
 	recv_file_model.cpp \
 	recv_file_map.cpp \
 	recv_file_transfer.cpp \
+	recv_file_writer.cpp \
 	recv_file_thread.cpp \
 	recvfilesortfilterproxymodel.cpp \
 	retry_recv_file_dialog.cpp \
 	recv_file_window.cpp \
 	send_file_model.cpp \
 	send_file_map.cpp \
+	send_file_set.cpp \
 	send_file.cpp \
-	send_file_handle.cpp \
 	send_file_thread.cpp \
+	send_file_thread_pool.cpp \
+	send_file_event_loop.cpp \
 	send_file_window.cpp \
 	send_file_manager.cpp \
 	serve_socket.cpp \
@@ -105,9 +124,13 @@ SOURCES += \
 	sizecolumndelegate.cpp \
 	systray.cpp \
 	file_server.cpp \
+	interface_monitor.cpp \
 	transfer_codec.cpp \
+	timer_wheel.cpp \
 	translator.cpp \
 	owner.cpp \
+	packet_parser.cpp \
+	presence_cache.cpp \
 	sound.cpp \
 	sound_thread.cpp \
 	user_manager.cpp \
@@ -0,0 +1,135 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// qipmsgd, QIpMsg without gui. Presence, msgs and file serving run as in
+// qipmsg, it is driven through the control socket, see ControlServer.
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTime>
+#include <QThread>
+#include <QSocketNotifier>
+
+#include "helper.h"
+#include "global.h"
+#include "lockfile.h"
+#include "file_server.h"
+#include "msg_thread.h"
+#include "user_manager.h"
+#include "control_server.h"
+#include "constants.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <signal.h>
+#include <unistd.h>
+
+static int signalFds[2];
+
+static void createHomeDirectory();
+static void writeSignal(int);
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qRegisterMetaType<Msg>("Msg");
+    qRegisterMetaType<QList<Owner> >("QList<Owner>");
+    qRegisterMetaType<QAbstractSocket::SocketError>("QAbstractSocket::SocketError");
+
+    createHomeDirectory();
+    Helper::setIniPath(Helper::appHomePath());
+    Helper::setAppPath(app.applicationDirPath());
+    Helper::setInternalLogFileName(Helper::appHomePath()
+                                   + "/qipmsgd_internal.log");
+
+    // Shares port 2425 with qipmsg, so only one of them may run.
+    LockFile::instance()->setLockFile(Helper::lockFile());
+    if (!LockFile::instance()->lock()) {
+        qWarning("qipmsgd: lock '%s' failed, exit.",
+                 Helper::lockFile().toUtf8().data());
+        return -1;
+    }
+
+    qsrand(QTime(0, 0, 0).secsTo(QTime::currentTime()));
+    Helper::setPacketNo(qrand() % 1024);
+
+    Global::globalInit(Helper::iniPath());
+
+    if (!Global::fileServer->isListening()) {
+        qWarning("qipmsgd: start tcp server error: %s",
+                 Global::fileServer->errorString().toUtf8().data());
+        return -1;
+    }
+
+    ControlServer controlServer;
+    if (!controlServer.listen()) {
+        return -1;
+    }
+
+    // handleError() of MsgThread already logged it.
+    QObject::connect(Global::msgThread, SIGNAL(fatalError(QString)),
+                     &app, SLOT(quit()));
+
+    Global::msgThread->start();
+    while (!Global::msgThread->isRunning()) {
+        QThread::msleep(10);
+    }
+
+    Global::userManager->loadPresenceCache();
+    Global::userManager->broadcastEntry();
+
+    // Quit on SIGINT and SIGTERM through event loop, so BR_EXIT is sent.
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, signalFds) == 0) {
+        QSocketNotifier *notifier
+            = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, &app);
+        QObject::connect(notifier, SIGNAL(activated(int)), &app, SLOT(quit()));
+        signal(SIGINT, writeSignal);
+        signal(SIGTERM, writeSignal);
+    }
+
+    int rc = app.exec();
+    if (Global::msgThread->hasFatalError()) {
+        rc = -1;
+    }
+
+    Global::userManager->broadcastExit();
+    Global::userManager->savePresenceCache();
+
+    Global::globalEnd();
+
+    return rc;
+}
+
+static void createHomeDirectory()
+{
+    if (!QFile::exists(Helper::appHomePath())) {
+        QDir d;
+        if (!d.mkdir(Helper::appHomePath())) {
+            qWarning("createHomeDirectory: can't create %s",
+                     Helper::appHomePath().toUtf8().data());
+        }
+    }
+}
+
+// Only async signal safe calls here, the event loop does the rest.
+static void writeSignal(int)
+{
+    char c = 1;
+    ssize_t n = write(signalFds[0], &c, sizeof(c));
+    (void)n;
+}
@@ -0,0 +1,93 @@
+# qipmsgd, headless QIpMsg without QtWidgets, controlled through the local
+# control socket. Build with: qmake qipmsgd.pro -o Makefile.qipmsgd
+TEMPLATE = app
+TARGET = qipmsgd
+
+CONFIG += qt warn_on release
+# XXX NOTE: gui is only for QStandardItemModel of UserManager and
+# SendFileManager, no QGuiApplication is created.
+QT = core gui network
+
+DEFINES += QIPMSG_DAEMON
+
+HEADERS += \
+	constants.h \
+	control_server.h \
+	dir_walker.h \
+	entry_responder.h \
+	file_server.h \
+	global.h \
+	helper.h \
+	interface_monitor.h \
+	ipmsg.h \
+	lockfile.h \
+	mpsc_queue.h \
+	msg.h \
+	msg_base.h \
+	msg_server.h \
+	msg_socket.h \
+	msg_thread.h \
+	owner.h \
+	packet_parser.h \
+	preferences.h \
+	presence_cache.h \
+	recv_msg.h \
+	send_file.h \
+	send_file_event_loop.h \
+	send_file_manager.h \
+	send_file_map.h \
+	send_file_set.h \
+	send_file_thread.h \
+	send_file_thread_pool.h \
+	send_msg.h \
+	serve_socket.h \
+	timer_wheel.h \
+	transfer_codec.h \
+	transfer_file_model.h \
+	user_manager.h \
+	version.h
+
+SOURCES += \
+	qipmsgd.cpp \
+	control_server.cpp \
+	dir_walker.cpp \
+	entry_responder.cpp \
+	file_server.cpp \
+	global.cpp \
+	helper.cpp \
+	interface_monitor.cpp \
+	lockfile.cpp \
+	msg.cpp \
+	msg_base.cpp \
+	msg_server.cpp \
+	msg_socket.cpp \
+	msg_thread.cpp \
+	owner.cpp \
+	packet_parser.cpp \
+	preferences.cpp \
+	presence_cache.cpp \
+	recv_msg.cpp \
+	send_file.cpp \
+	send_file_event_loop.cpp \
+	send_file_manager.cpp \
+	send_file_map.cpp \
+	send_file_set.cpp \
+	send_file_thread.cpp \
+	send_file_thread_pool.cpp \
+	send_msg.cpp \
+	serve_socket.cpp \
+	timer_wheel.cpp \
+	transfer_codec.cpp \
+	transfer_file_model.cpp \
+	user_manager.cpp
+
+unix {
+  # Objects differ from qipmsg ones by QIPMSG_DAEMON.
+  MOC_DIR = .moc-qipmsgd
+  OBJECTS_DIR = .obj-qipmsgd
+
+  DEFINES += DATA_PATH=$(DATA_PATH)
+  DEFINES += SOUND_PATH=$(SOUND_PATH)
+  DEFINES += TRANSLATION_PATH=$(TRANSLATION_PATH)
+  DEFINES += ICON_PATH=$(ICON_PATH)
+}
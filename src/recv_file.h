@@ -52,6 +52,7 @@ public:
 
     qint64 offset() const { return m_offset; }
     void addOffset(qint64 offset) { m_offset += offset; }
+    void setOffset(qint64 offset) { m_offset = offset; }
 
     qint64 bytesReaded() const { return m_bytesReaded; }
     void setBytesReaded(qint64 bytesReaded) { m_bytesReaded = bytesReaded; }
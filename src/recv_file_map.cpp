@@ -47,10 +47,13 @@ QString RecvFileMap::transferStatsInfo() const
 
 void RecvFileMap::resetStats()
 {
-    m_currentId = -1;
+    QMutexLocker locker(&m_statsLock);
+
+    m_currentId.store(-1);
     m_dirCount = 0;
     m_regularFileCount = 0;
     m_totalRegularFileCount = 0;
     m_totalBytesReaded = 0;
+    m_activeCount = 0;
 }
 
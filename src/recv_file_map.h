@@ -21,6 +21,9 @@
 
 #include <QDateTime>
 #include <QTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
 
 class RecvFileMap
 {
@@ -33,7 +36,7 @@ public:
     enum TransferStates { NotTransfer, Transfer };
 
     RecvFileMap(): m_currentId(-1), m_dirCount(0), m_regularFileCount(0),
-    m_totalRegularFileCount(0), m_totalBytesReaded(0),
+    m_totalRegularFileCount(0), m_totalBytesReaded(0), m_activeCount(0),
     m_state(Normal), m_transferState(NotTransfer) {}
 
     void resetStats();
@@ -42,34 +45,55 @@ public:
 
     QString fileNameJoin(QString sep) const;
 
-    void setCurrentId(int id) { m_currentId = id; }
-    int currentId() const { return m_currentId; }
+    // XXX NOTE: set by parallel receive workers and read by GUI, so atomic.
+    // With several files in flight it is just the latest one started.
+    void setCurrentId(int id) { m_currentId.store(id); }
+    int currentId() const { return m_currentId.load(); }
 
-    RecvFileHandle currentFile() const { return m_map[m_currentId]; }
+    RecvFileHandle currentFile() const { return m_map[m_currentId.load()]; }
 
     void setSaveFilePath(QString path) { m_saveFilePath = path; }
     QString saveFilePath() const { return m_saveFilePath; }
 
-    void incrDirCount() { ++m_dirCount; }
+    // XXX NOTE: stats are updated by parallel receive workers, so we lock
+    // here.
+    void incrDirCount() { QMutexLocker l(&m_statsLock); ++m_dirCount; }
     int dirCount() const { return m_dirCount; }
 
-    void incrRegularFileCount() { ++m_regularFileCount; }
+    void incrRegularFileCount() {
+        QMutexLocker l(&m_statsLock);
+        ++m_regularFileCount;
+    }
     int regularFileCount() const { return m_regularFileCount; }
 
-    void incrTotalRegularFileCount() { ++m_totalRegularFileCount; }
+    void incrTotalRegularFileCount() {
+        QMutexLocker l(&m_statsLock);
+        ++m_totalRegularFileCount;
+    }
     int totalRegularFileCount() const { return m_totalRegularFileCount; }
 
+    // Count of files being received at the same time
+    void incrActiveCount() { QMutexLocker l(&m_statsLock); ++m_activeCount; }
+    void decrActiveCount() { QMutexLocker l(&m_statsLock); --m_activeCount; }
+    int activeCount() const { return m_activeCount; }
+
     QString transferStatsInfo() const;
 
     QString secondStringUnit(int second) const;
 
-    void addBytesReaded(qint64 size) { m_totalBytesReaded += size; }
+    void addBytesReaded(qint64 size) {
+        QMutexLocker l(&m_statsLock);
+        m_totalBytesReaded += size;
+    }
 
     void setStartTime() { m_begin = QDateTime::currentDateTime(); }
     void setEndTime() { m_end = QDateTime::currentDateTime(); }
 
+    // While transfering, count to now.
     quint32 elapse() const {
-        return qMax(m_end.toTime_t() - m_begin.toTime_t(), (quint32)1);
+        QDateTime end = (m_transferState == Transfer)
+            ? QDateTime::currentDateTime() : m_end;
+        return qMax(end.toTime_t() - m_begin.toTime_t(), (quint32)1);
     }
 
     double totalTransferRateAvg() const {
@@ -87,7 +111,7 @@ public:
 
 private:
     // file id of file current transfered
-    int m_currentId;
+    QAtomicInt m_currentId;
     QMap<int, RecvFileHandle> m_map;
 
     int m_dirCount;
@@ -95,6 +119,8 @@ private:
     int m_totalRegularFileCount;
 
     qint64 m_totalBytesReaded;
+    int m_activeCount;
+    mutable QMutex m_statsLock;
 
     QDateTime m_begin;
     QDateTime m_end;
@@ -22,13 +22,27 @@
 #include "global.h"
 #include "user_manager.h"
 #include "transfer_codec.h"
+#include "preferences.h"
+#include "recv_file_writer.h"
 
 #include <QFile>
 #include <QDir>
 #include <QTextCodec>
+#include <QThread>
 
 #include <sys/types.h>
 #include <utime.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+// Only files not smaller than this are received in segments.
+#define RECV_FILE_SEGMENT_MIN_SIZE          (64*1024*1024LL)
+#define RECV_FILE_SEGMENT_BLOCK_SIZE        (64*1024)
+#define RECV_FILE_SEGMENT_STATS_INTERVAL    200
+
+#define RECV_DIR_BUFFER_SIZE                (256*1024)
 
 struct TransferFile
 {
@@ -38,11 +52,66 @@ struct TransferFile
     QMap<int, QString> extendAttr;
 };
 
+// Run a parallel receive worker in its own thread, so it has its own
+// QTcpSocket.
+class RecvFileWorkerThread : public QThread
+{
+public:
+    RecvFileWorkerThread(RecvFileMap *recvFileMap, RecvFileTransfer *master)
+        : m_recvFileMap(recvFileMap), m_master(master) {}
+
+    void run()
+    {
+        RecvFileTransfer transfer(m_recvFileMap, m_master);
+        transfer.recvJobs();
+    }
+
+private:
+    RecvFileMap *m_recvFileMap;
+    RecvFileTransfer *m_master;
+};
+
+// One segment of a segmented download, received in its own thread.
+class RecvFileSegmentThread : public QThread
+{
+public:
+    RecvFileSegmentThread(RecvFileMap *recvFileMap, RecvFileTransfer *master,
+                          RecvFileHandle &h, int fd,
+                          qint64 offset, qint64 length)
+        : m_recvFileMap(recvFileMap), m_master(master), m_handle(h), m_fd(fd),
+        offset(offset), length(length), bytesReaded(0), ok(false) {}
+
+    void run()
+    {
+        RecvFileTransfer transfer(m_recvFileMap, m_master);
+        ok = transfer.recvSegment(m_handle, m_fd, offset, length,
+                                  bytesReaded, errorString);
+    }
+
+private:
+    RecvFileMap *m_recvFileMap;
+    RecvFileTransfer *m_master;
+    RecvFileHandle &m_handle;
+    int m_fd;
+
+public:
+    const qint64 offset;
+    const qint64 length;
+    QAtomicInteger<qint64> bytesReaded;
+    bool ok;
+    QString errorString;
+};
+
 void RecvFileTransfer::startTransfer()
 {
     m_recvFileMap->setStartTime();
     m_recvFileMap->resetStats();
 
+    // XXX NOTE: we copy handles here before any worker started, workers
+    // only use them by reference.
+    m_jobs.clear();
+    m_nextJob = 0;
+    isJobFailed = false;
     foreach (RecvFileHandle h, m_recvFileMap->m_map) {
         if (h->state() == RecvFile::RecvOk
             || h->state() == RecvFile::NotRecv) {
@@ -50,47 +119,116 @@ void RecvFileTransfer::startTransfer()
         }
 
         h->resetStats();
+        m_jobs << h;
+    }
 
-        m_recvFileMap->setCurrentId(h->fileId());
-        m_recvFileMap->startTimer();
+    m_recvFileMap->startTimer();
 
-        m_tcpSocket.disconnectFromHost();
-        m_tcpSocket.connectToHost(h->ipAddress(), IPMSG_DEFAULT_PORT);
-        if (!m_tcpSocket.waitForConnected(1000)) {
-            m_errorString = m_tcpSocket.errorString();
-            goto transfer_fail;
-        }
+    // This thread is a worker too.
+    int connectionCount
+        = qMin(Global::preferences->maxRecvFileConnectionCount, m_jobs.size());
+    QList<RecvFileWorkerThread *> workers;
+    for (int i = 1; i < connectionCount; ++i) {
+        RecvFileWorkerThread *t = new RecvFileWorkerThread(m_recvFileMap, this);
+        workers << t;
+        t->start();
+    }
 
-        if (h->type() == IPMSG_FILE_REGULAR) {
-            if (!recvFileRegular(h)) {
-                goto transfer_fail;
-            }
-        } else if (h->type() == IPMSG_FILE_DIR) {
-            if (!recvFileDir(h)) {
-                goto transfer_fail;
-            }
-        }
+    recvJobs();
 
-        m_recvFileMap->stopTimer();
+    foreach (RecvFileWorkerThread *t, workers) {
+        t->wait();
+        delete t;
     }
 
-    m_tcpSocket.disconnectFromHost();
-    m_recvFileMap->setEndTime();
-    emit recvFileFinished();
-    return;
-
-transfer_fail:
-    m_tcpSocket.disconnectFromHost();
     m_recvFileMap->setEndTime();
     m_recvFileMap->stopTimer();
-    // if 'isAbortTransfer' is true, it's a manually stop, not emit error
-    if (!isAbortTransfer) {
+
+    if (!isJobFailed) {
+        emit recvFileFinished();
+    } else if (!isAbortTransfer) {
+        // if 'isAbortTransfer' is true, it's a manually stop, not emit error
         emit recvFileError(m_errorString);
     }
-    return;
 }
 
-bool RecvFileTransfer::recvFileRegular(RecvFileHandle h)
+void RecvFileTransfer::recvJobs()
+{
+    RecvFileHandle *h;
+    while ((h = m_master->takeJob()) != 0) {
+        bool ok = recvFile(*h);
+        m_recvFileMap->decrActiveCount();
+        if (!ok) {
+            m_master->setJobFailed(m_errorString);
+            break;
+        }
+    }
+
+    m_tcpSocket.disconnectFromHost();
+}
+
+RecvFileHandle *RecvFileTransfer::takeJob()
+{
+    QMutexLocker locker(&m_jobLock);
+
+    if (isJobFailed || isAbortTransfer || m_nextJob >= m_jobs.size()) {
+        return 0;
+    }
+
+    m_recvFileMap->incrActiveCount();
+
+    // XXX NOTE: m_jobs is never copied, so operator[] will not detach.
+    return &m_jobs[m_nextJob++];
+}
+
+void RecvFileTransfer::setJobFailed(QString errorString)
+{
+    QMutexLocker locker(&m_jobLock);
+
+    // keep the first error
+    if (!isJobFailed) {
+        isJobFailed = true;
+        m_errorString = errorString;
+    }
+}
+
+void RecvFileTransfer::waitIfStopped()
+{
+    QMutexLocker locker(&m_master->m_lock);
+
+    while (m_master->isStopTransfer) {
+        m_master->m_cond.wait(&m_master->m_lock);
+    }
+}
+
+bool RecvFileTransfer::recvFile(RecvFileHandle &h)
+{
+    m_recvFileMap->setCurrentId(h->fileId());
+
+    int segmentCount = Global::preferences->recvFileSegmentCount;
+    if (h->type() == IPMSG_FILE_REGULAR && segmentCount > 1
+        && m_recvFileMap->state() == RecvFileMap::Normal
+        && h->size() >= RECV_FILE_SEGMENT_MIN_SIZE) {
+        return recvFileSegmented(h, segmentCount);
+    }
+
+    m_tcpSocket.disconnectFromHost();
+    m_tcpSocket.connectToHost(h->ipAddress(), IPMSG_DEFAULT_PORT);
+    if (!m_tcpSocket.waitForConnected(1000)) {
+        m_errorString = m_tcpSocket.errorString();
+        return false;
+    }
+
+    if (h->type() == IPMSG_FILE_REGULAR) {
+        return recvFileRegular(h);
+    } else if (h->type() == IPMSG_FILE_DIR) {
+        return recvFileDir(h);
+    }
+
+    return true;
+}
+
+bool RecvFileTransfer::recvFileRegular(RecvFileHandle &h)
 {
     h->setStartTime();
 
@@ -101,54 +239,59 @@ bool RecvFileTransfer::recvFileRegular(RecvFileHandle h)
         return false;
     }
 
-    QFile file(m_recvFileMap->saveFilePath() + "/" + h->name());
-    QFlags<QIODevice::OpenModeFlag> flags;
+    qint64 offset = 0;
     if (m_recvFileMap->state() == RecvFileMap::Retry) {
-        flags = QIODevice::WriteOnly | QIODevice::Append;
-    } else {
-        flags = QIODevice::WriteOnly;
+        offset = h->offset();
     }
-    if (!file.open(flags)) {
-        m_errorString = file.errorString();
+
+    RecvFileWriter writer;
+    if (!writer.open(m_recvFileMap->saveFilePath() + "/" + h->name(),
+                     offset, h->size())) {
+        m_errorString = writer.errorString();
         return false;
     }
 
     qint64 bytesReaded = 0;
-    qint64 bytesToRead;
-    if (m_recvFileMap->state() == RecvFileMap::Retry) {
-        bytesToRead = h->size() - h->offset();
-    } else {
-        bytesToRead = h->size();
-    }
+    qint64 bytesToRead = h->size() - offset;
     while (bytesReaded < bytesToRead) {
-        if (!m_tcpSocket.waitForReadyRead(3000)) {
+        if (m_tcpSocket.bytesAvailable() == 0
+            && !m_tcpSocket.waitForReadyRead(3000)) {
             m_errorString = m_tcpSocket.errorString();
             goto recv_file_error;
         }
 
-        qint64 bytesAvailable = m_tcpSocket.bytesAvailable();
-        bytesReaded += bytesAvailable;
-
-        if (!saveData(m_tcpSocket.read(m_tcpSocket.bytesAvailable()), file)) {
-            goto recv_file_error;
-        }
+        {
+            qint64 n = m_tcpSocket.read(writer.buffer(),
+                    qMin(writer.bufferSpace(), bytesToRead - bytesReaded));
+            if (n < 0) {
+                m_errorString = m_tcpSocket.errorString();
+                goto recv_file_error;
+            }
+            bytesReaded += n;
 
-        // we need this because QTcpSocket error signal may happend any time
-        h->setBytesReaded(bytesReaded);
-        h->addOffset(bytesAvailable);
+            if (!writer.commit(n)) {
+                m_errorString = writer.errorString();
+                goto recv_file_error;
+            }
 
-        if (isStopTransfer) {
-            m_lock.lock();
-            m_cond.wait(&m_lock);
-            m_lock.unlock();
+            // we need this because QTcpSocket error signal may happend any time
+            h->setBytesReaded(bytesReaded);
+            h->addOffset(n);
         }
 
-        if (isAbortTransfer) {
+        waitIfStopped();
+
+        if (isAborted()) {
             goto recv_file_error;
         }
     }
 
-    file.close();
+    if (!writer.close()) {
+        m_errorString = writer.errorString();
+        h->setState(RecvFile::RecvFail);
+        m_recvFileMap->addBytesReaded(bytesReaded);
+        return false;
+    }
     // set modify time
     setLastModified(h);
     h->setState(RecvFile::RecvOk);
@@ -161,13 +304,173 @@ bool RecvFileTransfer::recvFileRegular(RecvFileHandle h)
     return true;
 
 recv_file_error:
-    file.close();
+    if (!writer.abort()) {
+        // File does not end where received data does, retry from start.
+        h->setOffset(0);
+    }
     h->setState(RecvFile::RecvFail);
     m_recvFileMap->addBytesReaded(bytesReaded);
 
     return false;
 }
 
+bool RecvFileTransfer::recvFileSegmented(RecvFileHandle &h, int segmentCount)
+{
+    h->setStartTime();
+
+    QString path = m_recvFileMap->saveFilePath() + "/" + h->name();
+    int fd = open(QFile::encodeName(path).constData(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd == -1) {
+        m_errorString = strerror(errno);
+        h->setState(RecvFile::RecvFail);
+        return false;
+    }
+
+    // Preallocate so that every segment writes in place.
+    if (posix_fallocate(fd, 0, h->size()) != 0
+        && ftruncate(fd, h->size()) == -1) {
+        m_errorString = strerror(errno);
+        close(fd);
+        h->setState(RecvFile::RecvFail);
+        return false;
+    }
+
+    QList<RecvFileSegmentThread *> segments;
+    qint64 segmentSize = (h->size() + segmentCount - 1) / segmentCount;
+    for (qint64 offset = 0; offset < h->size(); offset += segmentSize) {
+        RecvFileSegmentThread *t = new RecvFileSegmentThread(m_recvFileMap,
+                m_master, h, fd, offset, qMin(segmentSize, h->size() - offset));
+        segments << t;
+        t->start();
+    }
+
+    // Collect progress of all segments into file and map stats.
+    qint64 bytesReaded = 0;
+    forever {
+        bool isAllFinished = true;
+        foreach (RecvFileSegmentThread *t, segments) {
+            if (!t->wait(RECV_FILE_SEGMENT_STATS_INTERVAL)) {
+                isAllFinished = false;
+                break;
+            }
+        }
+
+        qint64 total = 0;
+        foreach (RecvFileSegmentThread *t, segments) {
+            total += t->bytesReaded.load();
+        }
+        m_recvFileMap->addBytesReaded(total - bytesReaded);
+        h->setBytesReaded(total);
+        bytesReaded = total;
+
+        if (isAllFinished) {
+            break;
+        }
+    }
+
+    // Length of leading data received without hole, retry go on from here.
+    bool ok = true;
+    qint64 prefix = 0;
+    bool isPrefixEnd = false;
+    foreach (RecvFileSegmentThread *t, segments) {
+        if (!t->ok) {
+            if (ok) {
+                m_errorString = t->errorString;
+            }
+            ok = false;
+        }
+        if (!isPrefixEnd) {
+            prefix += t->bytesReaded.load();
+            isPrefixEnd = (t->bytesReaded.load() < t->length);
+        }
+        delete t;
+    }
+
+    if (!ok) {
+        // File must end where retry goes on, or retry starts over.
+        if (ftruncate(fd, prefix) == -1) {
+            prefix = 0;
+        }
+        close(fd);
+        h->setOffset(prefix);
+        h->setState(RecvFile::RecvFail);
+        return false;
+    }
+
+    close(fd);
+    // set modify time
+    setLastModified(h);
+    h->setState(RecvFile::RecvOk);
+
+    h->incrRegularFileCount();
+    m_recvFileMap->incrRegularFileCount();
+    m_recvFileMap->incrTotalRegularFileCount();
+
+    return true;
+}
+
+bool RecvFileTransfer::recvSegment(RecvFileHandle &h, int fd,
+        qint64 offset, qint64 length, QAtomicInteger<qint64> &bytesReaded,
+        QString &errorString)
+{
+    m_tcpSocket.connectToHost(h->ipAddress(), IPMSG_DEFAULT_PORT);
+    if (!m_tcpSocket.waitForConnected(1000)) {
+        errorString = m_tcpSocket.errorString();
+        return false;
+    }
+
+    m_tcpSocket.write(constructRecvFileDatagram(h, offset, length));
+    if (!m_tcpSocket.waitForBytesWritten(3000)) {
+        errorString = m_tcpSocket.errorString();
+        return false;
+    }
+
+    char buf[RECV_FILE_SEGMENT_BLOCK_SIZE];
+    qint64 readed = 0;
+    while (readed < length) {
+        if (m_tcpSocket.bytesAvailable() == 0
+            && !m_tcpSocket.waitForReadyRead(3000)) {
+            errorString = m_tcpSocket.errorString();
+            return false;
+        }
+
+        // Never read beyond segment, sender may not support segment and
+        // send to the end of file.
+        qint64 n = m_tcpSocket.read(buf, qMin(length - readed,
+                                              (qint64)sizeof(buf)));
+        if (n < 0) {
+            errorString = m_tcpSocket.errorString();
+            return false;
+        }
+
+        qint64 written = 0;
+        while (written < n) {
+            ssize_t w = pwrite(fd, buf + written, n - written,
+                               offset + readed + written);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                errorString = strerror(errno);
+                return false;
+            }
+            written += w;
+        }
+        readed += n;
+        bytesReaded.store(readed);
+
+        waitIfStopped();
+        if (isAborted()) {
+            return false;
+        }
+    }
+
+    m_tcpSocket.disconnectFromHost();
+
+    return true;
+}
+
 void RecvFileTransfer::setLastModified(QString path, QString secondString)
 {
     if (!secondString.isEmpty()) {
@@ -183,7 +486,7 @@ void RecvFileTransfer::setLastModified(QString path, QString secondString)
     }
 }
 
-void RecvFileTransfer::setLastModified(RecvFileHandle h)
+void RecvFileTransfer::setLastModified(RecvFileHandle &h)
 {
     QString path = m_recvFileMap->saveFilePath() + "/" + h->name();
     QString s = h->attrMap().value(IPMSG_FILE_MTIME);
@@ -200,7 +503,7 @@ void RecvFileTransfer::setLastModified(RecvFileHandle h)
     }
 }
 
-bool RecvFileTransfer::recvFileDir(RecvFileHandle h)
+bool RecvFileTransfer::recvFileDir(RecvFileHandle &h)
 {
     h->setStartTime();
 
@@ -211,86 +514,69 @@ bool RecvFileTransfer::recvFileDir(RecvFileHandle h)
         return false;
     }
 
+    // XXX NOTE: headers and file data are parsed and written in place from
+    // this buffer. Only a partial header is ever left over after consuming
+    // the buffer, it is moved to front before next read, header size is
+    // at most 0xffff so it always fits.
+    if (m_recvBuffer.size() != RECV_DIR_BUFFER_SIZE) {
+        m_recvBuffer.resize(RECV_DIR_BUFFER_SIZE);
+    }
+    char *buffer = m_recvBuffer.data();
+    int begin = 0;
+    int end = 0;
+
     QDir dir(m_recvFileMap->saveFilePath());
-    QByteArray recvBlock;
     qint64 bytesToWrite = 0;
     bool isRecvContentData = false;
     QFile file;
     struct TransferFile transferFile;
     forever {
-        if (isStopTransfer) {
-            m_lock.lock();
-            m_cond.wait(&m_lock);
-            m_lock.unlock();
-        }
-        if (isAbortTransfer) {
-            h->setState(RecvFile::RecvFail);
-            return false;
-        }
-
-        if (!m_tcpSocket.waitForReadyRead(3000)) {
-            m_errorString = m_tcpSocket.errorString();
-            return false;
-        }
-
-        recvBlock.append(m_tcpSocket.read(m_tcpSocket.bytesAvailable()));
+        forever {
+            if (isRecvContentData) {
+                qint64 n = qMin(bytesToWrite, (qint64)(end - begin));
+                if (n > 0) {
+                    if (!saveData(buffer + begin, n, file)) {
+                        h->setState(RecvFile::RecvFail);
+                        return false;
+                    }
+                    h->addBytesReaded(n);
+                    m_recvFileMap->addBytesReaded(n);
+                    begin += n;
+                    bytesToWrite -= n;
+                }
+                if (bytesToWrite > 0) {
+                    break;
+                }
 
-        if (isRecvContentData) {
-            if (bytesToWrite > recvBlock.size()) {
-                saveData(recvBlock, file);
-                h->addBytesReaded(recvBlock.size());
-                m_recvFileMap->addBytesReaded(recvBlock.size());
-                bytesToWrite -= recvBlock.size();
-                recvBlock.clear();
-                continue;
-            } else {
                 isRecvContentData = false;
-                saveData(recvBlock.left(bytesToWrite), file);
-                h->addBytesReaded(bytesToWrite);
-                m_recvFileMap->addBytesReaded(bytesToWrite);
-                recvBlock.remove(0, bytesToWrite);
-                bytesToWrite = 0;
                 m_recvFileMap->incrTotalRegularFileCount();
                 h->incrRegularFileCount();
                 file.close();   // successfully get file
                 setLastModified(dir.absolutePath() + "/" + transferFile.name,
                                 transferFile.extendAttr.value(IPMSG_FILE_MTIME));
             }
-        }
 
-        while (!isRecvContentData && canParseHeader(recvBlock)) {
-            if (!parseHeader(recvBlock, transferFile)) {
+            int headerSize = parseHeader(buffer + begin, end - begin,
+                                         transferFile);
+            if (headerSize < 0) {
                 return false;
+            } else if (headerSize == 0) {
+                break;  // need more data
             }
+            begin += headerSize;
 
             if (transferFile.type == IPMSG_FILE_REGULAR) {
                 bytesToWrite = transferFile.size;
                 file.setFileName(dir.absolutePath() + "/" + transferFile.name);
-                if (!file.open(QIODevice::WriteOnly)) {
+                // XXX NOTE: data is written straight from the receive
+                // buffer in large chunks, QFile's own buffer would only add
+                // a copy.
+                if (!file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
                     m_errorString = "RecvFileTransfer::recvFileDir:"
                         + file.errorString();
                     return false;
                 }
-
-                if (bytesToWrite <= recvBlock.size()) {
-                    saveData(recvBlock.left(bytesToWrite), file);
-                    h->addBytesReaded(bytesToWrite);
-                    m_recvFileMap->addBytesReaded(bytesToWrite);
-                    recvBlock.remove(0, bytesToWrite);
-                    m_recvFileMap->incrTotalRegularFileCount();
-                    h->incrRegularFileCount();
-                    file.close();   // successfully get file
-                    setLastModified(dir.absolutePath() + "/"
-                                    + transferFile.name,
-                                    transferFile.extendAttr.value(IPMSG_FILE_MTIME));
-                } else {
-                    isRecvContentData = true;
-                    saveData(recvBlock, file);
-                    h->addBytesReaded(recvBlock.size());
-                    m_recvFileMap->addBytesReaded(recvBlock.size());
-                    bytesToWrite -= recvBlock.size();
-                    recvBlock.clear();
-                }
+                isRecvContentData = true;
             } else if (transferFile.type == IPMSG_FILE_DIR) {
                 if (m_recvFileMap->state() == RecvFileMap::Retry
                     && dir.exists(transferFile.name)) {
@@ -328,100 +614,144 @@ bool RecvFileTransfer::recvFileDir(RecvFileHandle h)
                 return false;
             }
         }
+
+        if (begin > 0) {
+            memmove(buffer, buffer + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+
+        waitIfStopped();
+        if (isAborted()) {
+            h->setState(RecvFile::RecvFail);
+            return false;
+        }
+
+        if (m_tcpSocket.bytesAvailable() == 0
+            && !m_tcpSocket.waitForReadyRead(3000)) {
+            m_errorString = m_tcpSocket.errorString();
+            return false;
+        }
+
+        qint64 n = m_tcpSocket.read(buffer + end, RECV_DIR_BUFFER_SIZE - end);
+        if (n < 0) {
+            m_errorString = m_tcpSocket.errorString();
+            return false;
+        }
+        end += n;
     }
 }
 
-bool RecvFileTransfer::parseHeader(QByteArray &recvBlock,
-                                   struct TransferFile &transferFile)
+// Parse a header at the beginning of 'data' without copying it.
+// Return header size, 0 if header is not complete in 'size' bytes yet, or -1
+// on error.
+int RecvFileTransfer::parseHeader(const char *data, int size,
+                                  struct TransferFile &transferFile)
 {
+    if (size < TRANSFER_FILE_HEADER_SIZE_LENGTH) {
+        return 0;
+    }
+
     bool ok;
-    int headerSize
-        = recvBlock.left(TRANSFER_FILE_HEADER_SIZE_LENGTH).toInt(&ok, 16);
-    if (!ok) {
+    int headerSize = QByteArray::fromRawData(data,
+            TRANSFER_FILE_HEADER_SIZE_LENGTH).toInt(&ok, 16);
+    if (!ok || headerSize <= TRANSFER_FILE_HEADER_SIZE_LENGTH) {
         m_errorString
             = "RecvFileTransfer::parseHeader: get headerSize error";
-        return false;
+        return -1;
+    }
+    if (size < headerSize) {
+        return 0;
     }
-
-    QByteArray header = recvBlock.left(headerSize);
-
-    QList<QByteArray> list = header.split(':');
 
 #define TRANSFERFILE_NAME_POS           1
 #define TRANSFERFILE_SIZE_POS           2
 #define TRANSFERFILE_TYPE_POS           3
 #define TRANSFERFILE_ATTR_BEGIN_POS     4
 
-    // XXX NOTE: canParseHeader() make sure we have enough items in list,
-    // so we do not need to check size of list before call list.at()
-    transferFile.name = Global::transferCodec->codec()
-        ->toUnicode(list.at(TRANSFERFILE_NAME_POS));
-    transferFile.size = list.at(TRANSFERFILE_SIZE_POS).toLongLong(&ok, 16);
-    if (!ok) {
-        m_errorString = "RecvFileTransfer::parseHeader: get file size error";
-        return false;
-    }
-    transferFile.type = list.at(TRANSFERFILE_TYPE_POS).toInt(&ok, 16);
-    if (!ok) {
-        m_errorString = "RecvFileTransfer::parseHeader: get file type error";
-        return false;
-    }
+    transferFile.extendAttr.clear();
 
-    // Extended file attribution like mtime, atime...
-    for (int i = TRANSFERFILE_ATTR_BEGIN_POS; i < list.size(); ++i) {
-        QString s = list.at(i);
-        QStringList l = s.split(QChar('='));
-        if (l.size() == 2) {
-            int i = l.at(0).toInt(&ok, 16);
-            if (ok) {
-                transferFile.extendAttr.insert(i, l.at(1));
+    int pos = 0;
+    const char *field = data;
+    const char *headerEnd = data + headerSize;
+    while (field < headerEnd) {
+        const char *sep = (const char *)memchr(field, ':', headerEnd - field);
+        if (sep == 0) {
+            sep = headerEnd;
+        }
+        QByteArray value = QByteArray::fromRawData(field, sep - field);
+
+        if (pos == TRANSFERFILE_NAME_POS) {
+            transferFile.name = Global::transferCodec->codec()
+                ->toUnicode(field, sep - field);
+        } else if (pos == TRANSFERFILE_SIZE_POS) {
+            transferFile.size = value.toLongLong(&ok, 16);
+            if (!ok) {
+                m_errorString
+                    = "RecvFileTransfer::parseHeader: get file size error";
+                return -1;
+            }
+        } else if (pos == TRANSFERFILE_TYPE_POS) {
+            transferFile.type = value.toInt(&ok, 16);
+            if (!ok) {
+                m_errorString
+                    = "RecvFileTransfer::parseHeader: get file type error";
+                return -1;
+            }
+        } else if (pos >= TRANSFERFILE_ATTR_BEGIN_POS) {
+            // Extended file attribution like mtime, atime...
+            const char *eq = (const char *)memchr(field, '=', sep - field);
+            if (eq != 0) {
+                int attr = QByteArray::fromRawData(field, eq - field)
+                    .toInt(&ok, 16);
+                if (ok) {
+                    transferFile.extendAttr.insert(attr,
+                            QString::fromLatin1(eq + 1, sep - eq - 1));
+                }
             }
         }
-    }
-
-    recvBlock.remove(0, headerSize);
-
-    return true;
-}
-
-bool RecvFileTransfer::canParseHeader(QByteArray &recvBlock)
-{
-    if (recvBlock.size() < TRANSFER_FILE_HEADER_SIZE_LENGTH)
-        return false;
 
-    bool ok;
-    int headerSize
-        = recvBlock.left(TRANSFER_FILE_HEADER_SIZE_LENGTH).toInt(&ok, 16);
+        ++pos;
+        field = sep + 1;
+    }
 
-    if (recvBlock.size() >= headerSize) {
-        return true;
+    if (pos < TRANSFERFILE_ATTR_BEGIN_POS) {
+        m_errorString = "RecvFileTransfer::parseHeader: header too short";
+        return -1;
     }
 
-    return false;
+    return headerSize;
 }
 
-bool RecvFileTransfer::saveData(QByteArray recvBlock, QFile &file)
+bool RecvFileTransfer::saveData(const char *data, qint64 size, QFile &file)
 {
-    qint64 bytesToWrite = recvBlock.size();
-
-    forever {
-        qint64 bytesWrited = file.write(recvBlock);
+    while (size > 0) {
+        qint64 bytesWrited = file.write(data, size);
 
         if (bytesWrited == -1) {
             m_errorString = file.errorString();
             return false;
         }
-        bytesToWrite -= bytesWrited;
-        if (bytesToWrite == 0) {
-            break;
-        }
-        recvBlock.remove(0, bytesWrited);
+        data += bytesWrited;
+        size -= bytesWrited;
     }
 
     return true;
 }
 
-QByteArray RecvFileTransfer::constructRecvFileDatagram(RecvFileHandle h)
+QByteArray RecvFileTransfer::constructRecvFileDatagram(const RecvFileHandle &h)
+{
+    if (m_recvFileMap->state() == RecvFileMap::Retry) {
+        return constructRecvFileDatagram(h, h->offset(), -1);
+    }
+
+    return constructRecvFileDatagram(h, 0/* offset */, -1);
+}
+
+// 'length' -1 means to the end of file, otherwise request a segment with our
+// extension field, which other clients simply ignore.
+QByteArray RecvFileTransfer::constructRecvFileDatagram(const RecvFileHandle &h,
+        qint64 offset, qint64 length)
 {
     QString s = QString("%1:%2:%3:%4").arg(IPMSG_VERSION)
         .arg(Helper::packetNoString())
@@ -441,10 +771,9 @@ QByteArray RecvFileTransfer::constructRecvFileDatagram(RecvFileHandle h)
             .arg(h->fileId(), 0, 16));
 
     if (h->type() == IPMSG_FILE_REGULAR) {
-        if (m_recvFileMap->state() == RecvFileMap::Retry) {
-            s.append(QString("%1:").arg(h->offset(), 0, 16));
-        } else {
-            s.append(QString("%1:").arg(0/* offset */, 0, 16));
+        s.append(QString("%1:").arg(offset, 0, 16));
+        if (length >= 0) {
+            s.append(QString("%1:").arg(length, 0, 16));
         }
     }
 
@@ -457,6 +786,7 @@ void RecvFileTransfer::stopTransfer()
 {
     qDebug() << "RecvFileTransfer::stopTransfer";
 
+    QMutexLocker locker(&m_lock);
     isStopTransfer = true;
 }
 
@@ -476,7 +806,8 @@ void RecvFileTransfer::resumeTransfer()
         // m_cond.wait() be called.
         m_lock.lock();
         isStopTransfer = false;
-        m_cond.wakeOne();
+        // wake all parallel workers
+        m_cond.wakeAll();
         m_lock.unlock();
     }
 }
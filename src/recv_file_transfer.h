@@ -23,6 +23,8 @@
 #include <QWaitCondition>
 #include <QObject>
 #include <QTcpSocket>
+#include <QList>
+#include <QAtomicInteger>
 
 class RecvFileMap;
 struct TransferFile;
@@ -35,13 +37,30 @@ class RecvFileTransfer : public QObject
 
 public:
     RecvFileTransfer(RecvFileMap *recvFileMap, QObject *parent = 0)
-        : QObject(parent), m_recvFileMap(recvFileMap),
+        : QObject(parent), m_recvFileMap(recvFileMap), m_master(this),
+        m_nextJob(0), isJobFailed(false),
+        isStopTransfer(false), isAbortTransfer(false) {}
+
+    // Worker of a parallel transfer, take files from and share stop/abort
+    // state with 'master'.
+    RecvFileTransfer(RecvFileMap *recvFileMap, RecvFileTransfer *master)
+        : QObject(0), m_recvFileMap(recvFileMap), m_master(master),
+        m_nextJob(0), isJobFailed(false),
         isStopTransfer(false), isAbortTransfer(false) {}
 
     void resumeTransfer();
 
     void startTransfer();
 
+    // Receive files taken from master until none left or one failed.
+    void recvJobs();
+
+    // Receive 'length' bytes from 'offset' of a regular file and write them
+    // at the same position of 'fd'.
+    bool recvSegment(RecvFileHandle &h, int fd, qint64 offset, qint64 length,
+                     QAtomicInteger<qint64> &bytesReaded,
+                     QString &errorString);
+
 signals:
     void recvFileFinished();
     void recvFileError(QString);
@@ -51,15 +70,23 @@ private slots:
     void abortTransfer();
 
 private:
-    QByteArray constructRecvFileDatagram(RecvFileHandle h);
-    bool recvFileRegular(RecvFileHandle h);
-    bool recvFileDir(RecvFileHandle h);
-    bool saveData(QByteArray recvBlock, QFile &file);
-    bool canParseHeader(QByteArray &recvBlock);
-    bool parseHeader(QByteArray &recvBlock,
-                     struct TransferFile &transferFile);
+    RecvFileHandle *takeJob();
+    void setJobFailed(QString errorString);
+    void waitIfStopped();
+    bool isAborted() const { return m_master->isAbortTransfer; }
+
+    bool recvFile(RecvFileHandle &h);
+    QByteArray constructRecvFileDatagram(const RecvFileHandle &h);
+    QByteArray constructRecvFileDatagram(const RecvFileHandle &h,
+                                         qint64 offset, qint64 length);
+    bool recvFileRegular(RecvFileHandle &h);
+    bool recvFileSegmented(RecvFileHandle &h, int segmentCount);
+    bool recvFileDir(RecvFileHandle &h);
+    bool saveData(const char *data, qint64 size, QFile &file);
+    int parseHeader(const char *data, int size,
+                    struct TransferFile &transferFile);
     void setLastModified(QString path, QString secondString);
-    void setLastModified(RecvFileHandle h);
+    void setLastModified(RecvFileHandle &h);
 
     QMutex m_lock;
     QWaitCondition m_cond;
@@ -67,6 +94,14 @@ private:
     QString m_errorString;
 
     QTcpSocket m_tcpSocket;
+    QByteArray m_recvBuffer;
+
+    // Parallel transfer states, only used in master
+    RecvFileTransfer *m_master;
+    QMutex m_jobLock;
+    QList<RecvFileHandle> m_jobs;
+    int m_nextJob;
+    bool isJobFailed;
 
     bool isStopTransfer;
     bool isAbortTransfer;
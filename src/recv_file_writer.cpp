@@ -0,0 +1,166 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "recv_file_writer.h"
+
+#include <QFile>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+#define RECV_FILE_WRITER_BUFFER_SIZE    (1024*1024)
+#define RECV_FILE_WRITER_ALIGNMENT      4096
+
+RecvFileWriter::RecvFileWriter()
+    : m_fd(-1), m_buffer(0), m_bufferSize(0), m_bufferUsed(0), m_offset(0),
+    m_dropOffset(0)
+{
+}
+
+RecvFileWriter::~RecvFileWriter()
+{
+    if (m_fd != -1) {
+        abort();
+    }
+    free(m_buffer);
+}
+
+bool RecvFileWriter::open(const QString &path, qint64 offset, qint64 size)
+{
+    if (m_buffer == 0) {
+        void *p;
+        if (posix_memalign(&p, RECV_FILE_WRITER_ALIGNMENT,
+                           RECV_FILE_WRITER_BUFFER_SIZE) != 0) {
+            m_errorString = strerror(ENOMEM);
+            return false;
+        }
+        m_buffer = (char *)p;
+        m_bufferSize = RECV_FILE_WRITER_BUFFER_SIZE;
+    }
+    m_bufferUsed = 0;
+
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    if (offset == 0) {
+        flags |= O_TRUNC;
+    }
+    m_fd = ::open(QFile::encodeName(path).constData(), flags, 0666);
+    if (m_fd == -1) {
+        m_errorString = strerror(errno);
+        return false;
+    }
+
+    // XXX NOTE: not all filesystems support preallocation, it is only an
+    // optimization, so errors are ignored.
+    if (size > offset) {
+        posix_fallocate(m_fd, offset, size - offset);
+    }
+#ifdef Q_OS_LINUX
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    m_offset = offset;
+    m_dropOffset = offset;
+
+    return true;
+}
+
+bool RecvFileWriter::commit(qint64 size)
+{
+    m_bufferUsed += size;
+    if (m_bufferUsed < m_bufferSize) {
+        return true;
+    }
+
+    return flush();
+}
+
+bool RecvFileWriter::flush()
+{
+    qint64 written = 0;
+    while (written < m_bufferUsed) {
+        ssize_t n = pwrite(m_fd, m_buffer + written, m_bufferUsed - written,
+                           m_offset + written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_errorString = strerror(errno);
+            return false;
+        }
+        written += n;
+    }
+
+#ifdef Q_OS_LINUX
+    // Start writeback of this block, then wait for the previous one and drop
+    // it from page cache, dirty pages can not be dropped.
+    sync_file_range(m_fd, m_offset, m_bufferUsed, SYNC_FILE_RANGE_WRITE);
+    if (m_offset > m_dropOffset) {
+        sync_file_range(m_fd, m_dropOffset, m_offset - m_dropOffset,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE
+                        | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(m_fd, m_dropOffset, m_offset - m_dropOffset,
+                      POSIX_FADV_DONTNEED);
+        m_dropOffset = m_offset;
+    }
+#endif
+
+    m_offset += m_bufferUsed;
+    m_bufferUsed = 0;
+
+    return true;
+}
+
+bool RecvFileWriter::close()
+{
+    bool ok = flush();
+    // Preallocated space past received data must not stay in the file.
+    if (ftruncate(m_fd, m_offset) == -1 && ok) {
+        m_errorString = strerror(errno);
+        ok = false;
+    }
+    if (ok && fdatasync(m_fd) == -1) {
+        m_errorString = strerror(errno);
+        ok = false;
+    }
+#ifdef Q_OS_LINUX
+    if (ok) {
+        posix_fadvise(m_fd, m_dropOffset, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+
+    ::close(m_fd);
+    m_fd = -1;
+
+    return ok;
+}
+
+bool RecvFileWriter::abort()
+{
+    bool ok = flush();
+    // Preallocated space past received data would make retry append at
+    // wrong position.
+    if (ftruncate(m_fd, m_offset) == -1) {
+        m_errorString = strerror(errno);
+        ok = false;
+    }
+
+    ::close(m_fd);
+    m_fd = -1;
+
+    return ok;
+}
@@ -0,0 +1,66 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef RECV_FILE_WRITER_H
+#define RECV_FILE_WRITER_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Write a received regular file of known size. Space is preallocated,
+// socket data is collected in an aligned buffer and written out in large
+// blocks at explicit offsets, written pages are dropped from page cache so
+// a big transfer does not flood it, and the file is fsync'ed once on close.
+class RecvFileWriter
+{
+public:
+    RecvFileWriter();
+    ~RecvFileWriter();
+
+    // Open 'path' to write from 'offset' on, the file will be 'size' bytes.
+    // 'offset' 0 truncates an existing file.
+    bool open(const QString &path, qint64 offset, qint64 size);
+
+    // Receive data directly into free space of buffer, then commit it.
+    char *buffer() { return m_buffer + m_bufferUsed; }
+    qint64 bufferSpace() const { return m_bufferSize - m_bufferUsed; }
+    bool commit(qint64 size);
+
+    // Flush, cut file to data written and fsync, return false on any
+    // error.
+    bool close();
+
+    // Close without fsync after a failure, keep only data written so far,
+    // so that retry can append to it. Return false if the file could not be
+    // cut there, then retry must start over.
+    bool abort();
+
+    QString errorString() const { return m_errorString; }
+
+private:
+    bool flush();
+
+    int m_fd;
+    char *m_buffer;
+    qint64 m_bufferSize;
+    qint64 m_bufferUsed;
+
+    qint64 m_offset;    // file offset of buffer begin
+    qint64 m_dropOffset;  // page cache before this offset has been dropped
+
+    QString m_errorString;
+};
+
+#endif // !RECV_FILE_WRITER_H
@@ -23,8 +23,8 @@ class RecvMsg : public MsgBase
 {
 public:
     RecvMsg() {}
-    RecvMsg(QString packet, QHostAddress address, quint16 port)
-        : MsgBase(packet, address, port) {}
+    RecvMsg(const PacketParser &parser, QHostAddress address, quint16 port)
+        : MsgBase(parser, address, port) {}
 
     virtual ~RecvMsg() {}
 
@@ -19,7 +19,8 @@
 
 
 SendFile::SendFile(QString path)
-    : QFileInfo(path), m_state(NotSend), m_fileId(-1), m_mtime(0)
+    : QFileInfo(path), m_state(NotSend), m_segmentSended(0), m_fileId(-1),
+    m_mtime(0)
 {
     // XXX TODO: finish this
     // m_mtime =
@@ -35,8 +35,15 @@ public:
 
     int type() const;
 
+    // Bytes served by segmented download requests, return the new total.
+    qint64 addSegmentSended(qint64 size) {
+        m_segmentSended += size;
+        return m_segmentSended;
+    }
+
 private:
     enum States m_state;
+    qint64 m_segmentSended;
 
     int m_fileId;
     time_t m_mtime;      // save this to trace if a file changed
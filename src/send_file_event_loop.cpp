@@ -0,0 +1,200 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "send_file_event_loop.h"
+#include "serve_socket.h"
+
+#include <QtDebug>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_EVENTS                      64
+
+SendFileEventLoop::SendFileEventLoop(QObject *parent)
+    : QThread(parent), m_isQuit(false), m_connectionCount(0)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // data.ptr == 0 means wake up event
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev);
+}
+
+SendFileEventLoop::~SendFileEventLoop()
+{
+    stop();
+    wait();
+
+    // XXX NOTE: program is quiting, sendFileManager may be deleted, so we
+    // just close the connections.
+    foreach (ServeSocket *serveSocket, m_connectionMap) {
+        delete serveSocket;
+    }
+    foreach (int socketDescriptor, m_pendingList) {
+        close(socketDescriptor);
+    }
+
+    close(m_wakeFd);
+    close(m_epollFd);
+}
+
+void SendFileEventLoop::addConnection(int socketDescriptor)
+{
+    int flags = fcntl(socketDescriptor, F_GETFL);
+    fcntl(socketDescriptor, F_SETFL, flags | O_NONBLOCK);
+
+    m_connectionCount.ref();
+
+    m_lock.lock();
+    m_pendingList << socketDescriptor;
+    m_lock.unlock();
+
+    wakeUp();
+}
+
+void SendFileEventLoop::stop()
+{
+    m_lock.lock();
+    m_isQuit = true;
+    m_lock.unlock();
+
+    wakeUp();
+}
+
+void SendFileEventLoop::wakeUp()
+{
+    quint64 one = 1;
+    while (write(m_wakeFd, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+}
+
+void SendFileEventLoop::run()
+{
+    qDebug("SendFileEventLoop::run: begin");
+
+    struct epoll_event events[MAX_EVENTS];
+
+    forever {
+        int n = epoll_wait(m_epollFd, events, MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qDebug() << "SendFileEventLoop::run: epoll_wait error" << errno;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            ServeSocket *serveSocket = (ServeSocket *)events[i].data.ptr;
+            if (serveSocket) {
+                handleEvents(serveSocket, events[i].events);
+            } else {
+                quint64 count;
+                while (read(m_wakeFd, &count, sizeof(count)) > 0) {
+                }
+                acceptPendingConnections();
+            }
+        }
+
+        QMutexLocker locker(&m_lock);
+        if (m_isQuit) {
+            break;
+        }
+    }
+
+    qDebug("SendFileEventLoop::run: end");
+}
+
+void SendFileEventLoop::acceptPendingConnections()
+{
+    m_lock.lock();
+    QList<int> list = m_pendingList;
+    m_pendingList.clear();
+    m_lock.unlock();
+
+    foreach (int socketDescriptor, list) {
+        ServeSocket *serveSocket = new ServeSocket(socketDescriptor);
+        m_connectionMap.insert(socketDescriptor, serveSocket);
+        if (!updateEvents(serveSocket, EPOLL_CTL_ADD)) {
+            closeConnection(serveSocket);
+        }
+    }
+}
+
+void SendFileEventLoop::handleEvents(ServeSocket *serveSocket, quint32 events)
+{
+    ServeSocket::IoStates oldState = serveSocket->ioState();
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        serveSocket->abortRequest();
+        closeConnection(serveSocket);
+        return;
+    }
+
+    bool ok = true;
+    if (serveSocket->ioState() == ServeSocket::ReadRequest
+        && (events & EPOLLIN)) {
+        ok = serveSocket->readRequest();
+    }
+    // Request parsed, try sending at once, socket is likely writable.
+    if (ok && serveSocket->ioState() == ServeSocket::SendData) {
+        ok = serveSocket->writeData();
+    }
+
+    if (!ok || serveSocket->ioState() == ServeSocket::Finished) {
+        closeConnection(serveSocket);
+        return;
+    }
+
+    if (serveSocket->ioState() != oldState
+        && !updateEvents(serveSocket, EPOLL_CTL_MOD)) {
+        serveSocket->abortRequest();
+        closeConnection(serveSocket);
+    }
+}
+
+bool SendFileEventLoop::updateEvents(ServeSocket *serveSocket, int op)
+{
+    struct epoll_event ev;
+    if (serveSocket->ioState() == ServeSocket::ReadRequest) {
+        ev.events = EPOLLIN;
+    } else {
+        ev.events = EPOLLOUT;
+    }
+    ev.data.ptr = serveSocket;
+
+    return (epoll_ctl(m_epollFd, op, serveSocket->socketDescriptor(), &ev)
+            != -1);
+}
+
+void SendFileEventLoop::closeConnection(ServeSocket *serveSocket)
+{
+    int socketDescriptor = serveSocket->socketDescriptor();
+
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, socketDescriptor, 0);
+    m_connectionMap.remove(socketDescriptor);
+
+    // ServeSocket close the socket.
+    delete serveSocket;
+
+    m_connectionCount.deref();
+}
@@ -0,0 +1,65 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef SEND_FILE_EVENT_LOOP_H
+#define SEND_FILE_EVENT_LOOP_H
+
+#include <QThread>
+#include <QMutex>
+#include <QList>
+#include <QMap>
+#include <QAtomicInt>
+
+class ServeSocket;
+
+// Serve many file transfer connections in one thread with epoll. Each
+// connection is a non-blocking ServeSocket, which read the request when
+// socket is readable, and stream header and file content when writable.
+class SendFileEventLoop : public QThread
+{
+    Q_OBJECT
+
+public:
+    SendFileEventLoop(QObject *parent = 0);
+    ~SendFileEventLoop();
+
+    void run();
+
+    // Thread safe, called from FileServer's thread.
+    void addConnection(int socketDescriptor);
+    void stop();
+
+    int connectionCount() const { return m_connectionCount.load(); }
+
+private:
+    void wakeUp();
+    void acceptPendingConnections();
+    void handleEvents(ServeSocket *serveSocket, quint32 events);
+    bool updateEvents(ServeSocket *serveSocket, int op);
+    void closeConnection(ServeSocket *serveSocket);
+
+    int m_epollFd;
+    int m_wakeFd;
+
+    QMutex m_lock;
+    QList<int> m_pendingList;
+    bool m_isQuit;
+
+    // Only used in loop thread
+    QMap<int, ServeSocket *> m_connectionMap;
+    QAtomicInt m_connectionCount;
+};
+
+#endif // !SEND_FILE_EVENT_LOOP_H
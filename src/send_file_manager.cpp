@@ -28,7 +28,7 @@ SendFileManager::~SendFileManager()
     // }
 }
 
-void SendFileManager::addTransfer(QString key, SendFileMap *value)
+void SendFileManager::addTransfer(qint64 key, SendFileMap *value)
 {
     transferFileMap.insert(key, value);
     transferFileModel.insertTransfer(value);
@@ -36,7 +36,7 @@ void SendFileManager::addTransfer(QString key, SendFileMap *value)
     emit transferCountChanged(transferFileMap.count());
 }
 
-void SendFileManager::addTransferLocked(QString key, SendFileMap *value)
+void SendFileManager::addTransferLocked(qint64 key, SendFileMap *value)
 {
     // XXX NOTE: we need lock here, 'SendFileThread' call removeTransfer()
     // directly
@@ -48,13 +48,19 @@ void SendFileManager::addTransferLocked(QString key, SendFileMap *value)
     emit transferCountChanged(transferFileMap.count());
 }
 
-void SendFileManager::removeTransfer(QString key)
+int SendFileManager::transferCount()
+{
+    QMutexLocker locker(&m_lock);
+
+    return transferFileMap.count();
+}
+
+void SendFileManager::removeTransfer(qint64 key)
 {
     // XXX NOTE: we need lock here, 'SendFileThread' call this directly.
     // QMutexLocker locker(&m_lock);
 
-    SendFileMap *map = transferFileMap.value(key);
-    transferFileMap.remove(key);
+    SendFileMap *map = transferFileMap.take(key);
     if (map) {
         delete map;
     }
@@ -64,12 +70,11 @@ void SendFileManager::removeTransfer(QString key)
     emit transferCountChanged(transferFileMap.count());
 }
 
-void SendFileManager::removeTransferLocked(QString key)
+void SendFileManager::removeTransferLocked(qint64 key)
 {
     QMutexLocker locker(&m_lock);
 
-    SendFileMap *map = transferFileMap.value(key);
-    transferFileMap.remove(key);
+    SendFileMap *map = transferFileMap.take(key);
     if (map) {
         delete map;
     }
@@ -21,7 +21,7 @@
 #include "send_file_map.h"
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
 #include <QMutex>
 
 class SendFileMap;
@@ -37,18 +37,20 @@ public:
     SendFileManager() {}
     ~SendFileManager();
 
-    void addTransfer(QString, SendFileMap *);
-    void addTransferLocked(QString, SendFileMap *);
+    void addTransfer(qint64 packetNo, SendFileMap *);
+    void addTransferLocked(qint64 packetNo, SendFileMap *);
+
+    int transferCount();
 
     TransferFileModel transferFileModel;
-    QMap<QString, SendFileMap *> transferFileMap;
+    QHash<qint64, SendFileMap *> transferFileMap;
 
 signals:
     void transferCountChanged(int);
 
 public slots:
-    void removeTransfer(QString key);
-    void removeTransferLocked(QString key);
+    void removeTransfer(qint64 key);
+    void removeTransferLocked(qint64 key);
 
 private:
     QMutex m_lock;
@@ -15,109 +15,28 @@
 //
 
 #include "send_file_map.h"
-#include "send_file.h"
-#include "constants.h"
-#include "helper.h"
 
-#include <QStringList>
-#include <QList>
-#include <QDateTime>
-#include <QtDebug>
-
-SendFileMap::SendFileMap(QObject *parent)
-    : QObject(parent), m_transferedCount(0), m_state(NotTransfer)
-{
-}
-
-void SendFileMap::addFile(const QStringList &pathList)
-{
-    int id = 0;
-    foreach (QString path, pathList) {
-        SendFile sendFile(path);
-        m_map.insert(id, SendFileHandle(sendFile));
-        ++id;
-    }
-}
-
-QString SendFileMap::packetString() const
-{
-    QList<int> keys = m_map.keys();
-    QString fileInfoString;
-
-    foreach (int key, keys) {
-        SendFileHandle h = m_map.value(key);
-
-        QString s = QString("%1").arg(key);
-        s.append(COMMAND_SEPERATOR);
-        s.append(h->fileName().replace(":", "::"));
-        s.append(COMMAND_SEPERATOR);
-        s.append(QString("%1").arg(h->size(), 2, 16, QChar('0')));
-        s.append(COMMAND_SEPERATOR);
-        s.append(QString("%1").arg(h->lastModified().toTime_t(),
-                    0, 16));
-        s.append(COMMAND_SEPERATOR);
-        if (h->isFile()) {
-            s.append(QString("%1").arg(IPMSG_FILE_REGULAR));
-        } else if (h->isDir()) {
-            s.append(QString("%1").arg(IPMSG_FILE_DIR));
-        }
-        s.append(COMMAND_SEPERATOR);
-        s.append(QString("%1=").arg(IPMSG_FILE_MTIME, 0, 16));
-        s.append(QString("%1").arg(h->lastModified().toTime_t(), 0, 16));
-        s.append(COMMAND_SEPERATOR);
-        s.append(QString("%1=").arg(IPMSG_FILE_CREATETIME, 0, 16));
-        s.append(QString("%1").arg(h->created().toTime_t(), 0, 16));
-        s.append(COMMAND_SEPERATOR);
-        s.append(FILELIST_SEPARATOR);
-
-        fileInfoString.append(s);
-    }
-
-    return fileInfoString;
-}
-
-QString SendFileMap::fileNames() const
+SendFileMap::SendFileMap(const SendFileSet &fileSet, QObject *parent)
+    : QObject(parent), m_fileSet(fileSet), m_sendOkCount(0), m_packetNo(0),
+    m_transferedCount(0), m_state(NotTransfer)
 {
-    QStringList items;
-
-    foreach (SendFileHandle h, m_map) {
-        items << h->fileName();
-    }
-
-    return items.join(" ");
 }
 
-QString SendFileMap::sizeInfo() const
+void SendFileMap::setFileState(int fileId, SendFile::States state)
 {
-    int dirCount = 0;
-    int regularFileCount = 0;
-    qint64 size = 0;
-
-    foreach (SendFileHandle h, m_map) {
-        if (h->isDir()) {
-            ++dirCount;
-        } else {
-            ++regularFileCount;
-            size += h->size();
-        }
-    }
-
-    QString s;
-    if (regularFileCount > 0) {
-        s = Helper::sizeStringUnit(size);
-    }
-
-    if (dirCount > 0) {
-        s = s + (regularFileCount > 0 ? "/" : "") + QString("%1").arg(dirCount)
-            + " " + (dirCount > 1 ? tr("Folders") : tr("Folder"));
+    FileState &fileState = m_fileStates[fileId];
+    if (fileState.state != SendFile::SendOk && state == SendFile::SendOk) {
+        ++m_sendOkCount;
+    } else if (fileState.state == SendFile::SendOk
+               && state != SendFile::SendOk) {
+        --m_sendOkCount;
     }
-
-    return s;
+    fileState.state = state;
 }
 
 QString SendFileMap::sendStats() const
 {
-    return QString("%1/%2/%3/").arg(m_map.count(), 1, 10)
+    return QString("%1/%2/%3/").arg(m_fileSet.count(), 1, 10)
         .arg(m_transferedCount)
         .arg(isTransfer() ? 1 : 0);
 }
@@ -134,8 +53,8 @@ QString SendFileMap::recvUserInfo() const
 
 bool SendFileMap::canSendFile(int fileId) const
 {
-    if (m_map.contains(fileId)
-        && m_map[fileId]->state() != SendFile::SendOk) {
+    if (m_fileSet.contains(fileId)
+        && fileState(fileId) != SendFile::SendOk) {
         return true;
     }
 
@@ -144,12 +63,5 @@ bool SendFileMap::canSendFile(int fileId) const
 
 bool SendFileMap::isFinished() const
 {
-    foreach (SendFileHandle h, m_map) {
-        if (h->state() != SendFile::SendOk) {
-            return false;
-        }
-    }
-
-    return true;
+    return m_sendOkCount == m_fileSet.count();
 }
-
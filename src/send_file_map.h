@@ -17,15 +17,17 @@
 #ifndef SEND_FILE_MAP_H
 #define SEND_FILE_MAP_H
 
-#include "send_file_handle.h"
+#include "send_file_set.h"
 
-#include <QMap>
+#include <QObject>
+#include <QHash>
 #include <QString>
 #include <QSemaphore>
 
-class QStringList;
-
 
+// Transfer ticket of one recipient. Files are shared with the other
+// recipients through SendFileSet, only files this recipient has requested
+// get a state entry here.
 class SendFileMap : public QObject
 {
     Q_OBJECT
@@ -35,24 +37,42 @@ public:
 
     enum States { NotTransfer, Transfer };
 
-    SendFileMap(QObject *parent = 0);
+    SendFileMap(const SendFileSet &fileSet, QObject *parent = 0);
 
-    void addFile(const QStringList&);
-    QString packetString() const;
+    const SendFileSet &fileSet() const { return m_fileSet; }
+    QString packetString() const { return m_fileSet.packetString(); }
 
     void setRecvUser(QString user) { m_recvUser = user; }
     void setRecvHostname(QString hostname) { m_recvHostname = hostname; }
 
-    void setPacketNoString(QString s) { m_packetNoString = s; }
-    QString packetNoString() const { return m_packetNoString; }
+    void setPacketNo(qint64 packetNo) { m_packetNo = packetNo; }
+    qint64 packetNo() const { return m_packetNo; }
+    QString packetNoString() const { return QString::number(m_packetNo); }
 
-    QString fileNames() const;
-    QString sizeInfo() const;
+    QString fileNames() const { return m_fileSet.fileNames(); }
+    QString sizeInfo() const { return m_fileSet.sizeInfo(); }
     QString sendStats() const;
     QString recvUserInfo() const;
 
     bool canSendFile(int fileId) const;
 
+    // XXX NOTE: fileId must be valid, see canSendFile().
+    int fileType(int fileId) const { return m_fileSet.file(fileId).type(); }
+    QString filePath(int fileId) const {
+        return m_fileSet.file(fileId).absoluteFilePath();
+    }
+    qint64 fileSize(int fileId) const { return m_fileSet.file(fileId).size(); }
+
+    SendFile::States fileState(int fileId) const {
+        return m_fileStates.value(fileId).state;
+    }
+    void setFileState(int fileId, SendFile::States state);
+
+    // Bytes served by segmented download requests, return the new total.
+    qint64 addSegmentSended(int fileId, qint64 size) {
+        return m_fileStates[fileId].segmentSended += size;
+    }
+
     void setState(States state) { m_state = state; }
     States state() const { return m_state; }
 
@@ -63,11 +83,21 @@ public:
     void incrTransferCount() { ++m_transferedCount; }
 
 private:
-    QMap<int, SendFileHandle> m_map;
+    struct FileState
+    {
+        FileState() : state(SendFile::NotSend), segmentSended(0) {}
+
+        SendFile::States state;
+        qint64 segmentSended;
+    };
+
+    SendFileSet m_fileSet;
+    QHash<int, FileState> m_fileStates;
+    int m_sendOkCount;
 
     QString m_recvUser;
     QString m_recvHostname;
-    QString m_packetNoString;
+    qint64 m_packetNo;
     int m_transferedCount;
     States m_state;
     QSemaphore sem;
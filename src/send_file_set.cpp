@@ -0,0 +1,110 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "send_file_set.h"
+#include "constants.h"
+#include "helper.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+
+SendFileSet::SendFileSet()
+{
+}
+
+SendFileSet::SendFileSet(const QStringList &pathList)
+{
+    Data *data = new Data;
+
+    QStringList names;
+    foreach (QString path, pathList) {
+        data->files << SendFile(path);
+        names << data->files.last().fileName();
+    }
+
+    data->packetString = makePacketString(data->files);
+    data->fileNames = names.join(" ");
+    data->sizeInfo = makeSizeInfo(data->files);
+
+    d = data;
+}
+
+QString SendFileSet::makePacketString(const QList<SendFile> &files)
+{
+    QString fileInfoString;
+
+    for (int id = 0; id < files.size(); ++id) {
+        const SendFile &f = files.at(id);
+
+        QString s = QString("%1").arg(id);
+        s.append(COMMAND_SEPERATOR);
+        s.append(f.fileName().replace(":", "::"));
+        s.append(COMMAND_SEPERATOR);
+        s.append(QString("%1").arg(f.size(), 2, 16, QChar('0')));
+        s.append(COMMAND_SEPERATOR);
+        s.append(QString("%1").arg(f.lastModified().toTime_t(),
+                    0, 16));
+        s.append(COMMAND_SEPERATOR);
+        if (f.isFile()) {
+            s.append(QString("%1").arg(IPMSG_FILE_REGULAR));
+        } else if (f.isDir()) {
+            s.append(QString("%1").arg(IPMSG_FILE_DIR));
+        }
+        s.append(COMMAND_SEPERATOR);
+        s.append(QString("%1=").arg(IPMSG_FILE_MTIME, 0, 16));
+        s.append(QString("%1").arg(f.lastModified().toTime_t(), 0, 16));
+        s.append(COMMAND_SEPERATOR);
+        s.append(QString("%1=").arg(IPMSG_FILE_CREATETIME, 0, 16));
+        s.append(QString("%1").arg(f.created().toTime_t(), 0, 16));
+        s.append(COMMAND_SEPERATOR);
+        s.append(FILELIST_SEPARATOR);
+
+        fileInfoString.append(s);
+    }
+
+    return fileInfoString;
+}
+
+QString SendFileSet::makeSizeInfo(const QList<SendFile> &files)
+{
+    int dirCount = 0;
+    int regularFileCount = 0;
+    qint64 size = 0;
+
+    foreach (const SendFile &f, files) {
+        if (f.isDir()) {
+            ++dirCount;
+        } else {
+            ++regularFileCount;
+            size += f.size();
+        }
+    }
+
+    QString s;
+    if (regularFileCount > 0) {
+        s = Helper::sizeStringUnit(size);
+    }
+
+    // Keep the translations of SendFileMap, where this came from.
+    if (dirCount > 0) {
+        s = s + (regularFileCount > 0 ? "/" : "") + QString("%1").arg(dirCount)
+            + " " + (dirCount > 1
+                     ? QCoreApplication::translate("SendFileMap", "Folders")
+                     : QCoreApplication::translate("SendFileMap", "Folder"));
+    }
+
+    return s;
+}
@@ -0,0 +1,66 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SEND_FILE_SET_H
+#define SEND_FILE_SET_H
+
+#include "send_file.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QSharedData>
+#include <QExplicitlySharedDataPointer>
+
+// Files attached to one msg. It is built once, stat and packet string
+// included, and shared read only by the SendFileMap of every recipient,
+// so sending to many users keeps one copy of the file list. Copies are
+// cheap and the use count is atomic, the set may be used in any thread.
+class SendFileSet
+{
+public:
+    SendFileSet();
+    explicit SendFileSet(const QStringList &pathList);
+
+    bool isEmpty() const { return count() == 0; }
+    int count() const { return d ? d->files.size() : 0; }
+    bool contains(int fileId) const {
+        return fileId >= 0 && fileId < count();
+    }
+
+    // XXX NOTE: fileId must be valid, see contains().
+    const SendFile &file(int fileId) const { return d->files.at(fileId); }
+
+    QString packetString() const { return d ? d->packetString : QString(); }
+    QString fileNames() const { return d ? d->fileNames : QString(); }
+    QString sizeInfo() const { return d ? d->sizeInfo : QString(); }
+
+private:
+    struct Data : public QSharedData
+    {
+        QList<SendFile> files;      // index is file id
+        QString packetString;
+        QString fileNames;
+        QString sizeInfo;
+    };
+
+    static QString makePacketString(const QList<SendFile> &files);
+    static QString makeSizeInfo(const QList<SendFile> &files);
+
+    QExplicitlySharedDataPointer<const Data> d;
+};
+
+#endif // !SEND_FILE_SET_H
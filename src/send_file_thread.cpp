@@ -19,6 +19,7 @@
 #include "transfer_codec.h"
 #include "serve_socket.h"
 #include "send_file_thread.h"
+#include "send_file_thread_pool.h"
 
 #include <QFile>
 #include <QtDebug>
@@ -28,8 +29,8 @@
 #include <QDir>
 #include <QDateTime>
 
-SendFileThread::SendFileThread(int socketDescriptor, QObject *parent)
-    : QThread(parent), m_socketDescriptor(socketDescriptor)
+SendFileThread::SendFileThread(SendFileThreadPool *pool, QObject *parent)
+    : QThread(parent), m_pool(pool)
 {
 }
 
@@ -37,9 +38,17 @@ void SendFileThread::run()
 {
     qDebug("SendFileThread::run: begin");
 
-    ServeSocket serveSocket(m_socketDescriptor);
+    int socketDescriptor;
+    QString peer;
+    while ((socketDescriptor = m_pool->takeConnection(&peer)) != -1) {
+        ServeSocket serveSocket(socketDescriptor);
 
-    serveSocket.startSendFile();
+        serveSocket.startSendFile();
+
+        // XXX NOTE: before serveSocket closes the socket, once closed its
+        // descriptor may be reused by the next accepted connection.
+        m_pool->finishConnection(socketDescriptor, peer);
+    }
 
     qDebug("SendFileThread::run: end");
 }
@@ -20,12 +20,16 @@
 #include <QThread>
 #include <QTcpSocket>
 
+class SendFileThreadPool;
+
+// Worker of SendFileThreadPool, serve connections taken from the pool until
+// the pool is shutting down.
 class SendFileThread : public QThread
 {
     Q_OBJECT
 
 public:
-    SendFileThread(int socketDescriptor, QObject *parent = 0);
+    SendFileThread(SendFileThreadPool *pool, QObject *parent = 0);
 
     void run();
 
@@ -39,7 +43,7 @@ private slots:
 #endif
 
 private:
-    int m_socketDescriptor;
+    SendFileThreadPool *m_pool;
 };
 
 #endif // !SEND_FILE_THREAD_H
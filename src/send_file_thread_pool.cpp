@@ -0,0 +1,229 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "send_file_thread_pool.h"
+#include "send_file_thread.h"
+
+#include <QtDebug>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DEFAULT_MAX_THREAD_COUNT        8
+
+SendFileThreadPool::SendFileThreadPool(QObject *parent)
+    : QObject(parent), m_maxThreadCount(DEFAULT_MAX_THREAD_COUNT),
+    m_idleCount(0), m_activeCount(0), m_queueDepth(0), m_isQuit(false)
+{
+}
+
+SendFileThreadPool::~SendFileThreadPool()
+{
+    m_lock.lock();
+    m_isQuit = true;
+    m_cond.wakeAll();
+    // Workers blocked in send() to a stalled peer return with an error.
+    foreach (int socketDescriptor, m_activeSockets) {
+        shutdown(socketDescriptor, SHUT_RDWR);
+    }
+    m_lock.unlock();
+
+    // XXX NOTE: workers use this pool until they return, so wait for all.
+    foreach (SendFileThread *t, m_threads + m_retiredThreads) {
+        t->wait();
+        delete t;
+    }
+
+    // Close connections never served.
+    foreach (QQueue<int> queue, m_pendingMap) {
+        foreach (int socketDescriptor, queue) {
+            close(socketDescriptor);
+        }
+    }
+}
+
+void SendFileThreadPool::addConnection(int socketDescriptor)
+{
+    QMutexLocker locker(&m_lock);
+
+    QString peer = peerKey(socketDescriptor);
+
+    if (!m_pendingMap.contains(peer) || m_pendingMap[peer].isEmpty()) {
+        m_peerOrder.append(peer);
+    }
+    m_pendingMap[peer].enqueue(socketDescriptor);
+    ++m_queueDepth;
+
+    if (m_idleCount < m_queueDepth && m_threads.size() < m_maxThreadCount) {
+        startWorkerNotLock();
+    }
+
+    m_cond.wakeOne();
+}
+
+void SendFileThreadPool::setMaxThreadCount(int count)
+{
+    QMutexLocker locker(&m_lock);
+
+    m_maxThreadCount = qMax(count, 1);
+
+    // Let idle workers above the limit see it and quit.
+    if (m_threads.size() > m_maxThreadCount) {
+        m_cond.wakeAll();
+    }
+
+    while (m_idleCount < m_queueDepth && m_threads.size() < m_maxThreadCount) {
+        startWorkerNotLock();
+    }
+}
+
+int SendFileThreadPool::maxThreadCount() const
+{
+    QMutexLocker locker(&m_lock);
+
+    return m_maxThreadCount;
+}
+
+int SendFileThreadPool::queueDepth() const
+{
+    QMutexLocker locker(&m_lock);
+
+    return m_queueDepth;
+}
+
+int SendFileThreadPool::activeWorkerCount() const
+{
+    QMutexLocker locker(&m_lock);
+
+    return m_activeCount;
+}
+
+int SendFileThreadPool::takeConnection(QString *peer)
+{
+    QMutexLocker locker(&m_lock);
+
+    ++m_idleCount;
+    while (!m_isQuit && m_queueDepth == 0
+           && m_threads.size() <= m_maxThreadCount) {
+        m_cond.wait(&m_lock);
+    }
+    --m_idleCount;
+
+    if (m_isQuit) {
+        return -1;
+    }
+
+    // Pool was shrunk, this worker quits.
+    if (m_threads.size() > m_maxThreadCount) {
+        SendFileThread *t = qobject_cast<SendFileThread *>(
+                QThread::currentThread());
+        m_threads.removeOne(t);
+        m_retiredThreads << t;
+        // The connection we may have been woken for goes to another one.
+        if (m_queueDepth > 0) {
+            m_cond.wakeOne();
+        }
+        return -1;
+    }
+
+    // Pick the peer with fewest active connections, first in round robin
+    // order wins on tie.
+    int index = 0;
+    int minActive = m_activePerPeer.value(m_peerOrder.at(0));
+    for (int i = 1; i < m_peerOrder.size(); ++i) {
+        int active = m_activePerPeer.value(m_peerOrder.at(i));
+        if (active < minActive) {
+            minActive = active;
+            index = i;
+        }
+    }
+
+    QString key = m_peerOrder.takeAt(index);
+    int socketDescriptor = m_pendingMap[key].dequeue();
+    if (m_pendingMap[key].isEmpty()) {
+        m_pendingMap.remove(key);
+    } else {
+        m_peerOrder.append(key);
+    }
+
+    --m_queueDepth;
+    ++m_activeCount;
+    ++m_activePerPeer[key];
+    m_activeSockets.insert(socketDescriptor);
+
+    *peer = key;
+    return socketDescriptor;
+}
+
+void SendFileThreadPool::finishConnection(int socketDescriptor,
+                                          const QString &peer)
+{
+    QMutexLocker locker(&m_lock);
+
+    m_activeSockets.remove(socketDescriptor);
+    if (--m_activePerPeer[peer] <= 0) {
+        m_activePerPeer.remove(peer);
+    }
+    --m_activeCount;
+}
+
+QString SendFileThreadPool::peerKey(int socketDescriptor) const
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+
+    if (getpeername(socketDescriptor, (struct sockaddr *)&addr, &len) == -1) {
+        return QString();
+    }
+
+    char buf[INET6_ADDRSTRLEN];
+    const char *s = 0;
+    if (addr.ss_family == AF_INET) {
+        s = inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr,
+                      buf, sizeof(buf));
+    } else if (addr.ss_family == AF_INET6) {
+        s = inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr,
+                      buf, sizeof(buf));
+    }
+
+    return s ? QString(s) : QString();
+}
+
+void SendFileThreadPool::reapRetiredNotLock()
+{
+    QList<SendFileThread *>::iterator it = m_retiredThreads.begin();
+    while (it != m_retiredThreads.end()) {
+        if ((*it)->isFinished()) {
+            delete *it;
+            it = m_retiredThreads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SendFileThreadPool::startWorkerNotLock()
+{
+    reapRetiredNotLock();
+
+    SendFileThread *t = new SendFileThread(this);
+    m_threads << t;
+    t->start();
+
+    qDebug() << "SendFileThreadPool::startWorkerNotLock: workers"
+        << m_threads.size();
+}
@@ -0,0 +1,84 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef SEND_FILE_THREAD_POOL_H
+#define SEND_FILE_THREAD_POOL_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QQueue>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+
+class SendFileThread;
+
+// Bounded pool of SendFileThread workers serving incoming file transfer
+// connections. Connections exceeding the pool size are queued per peer, and
+// workers take them round robin from the peer with fewest active
+// connections, so one peer pulling many files can not starve the others.
+class SendFileThreadPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    SendFileThreadPool(QObject *parent = 0);
+    ~SendFileThreadPool();
+
+    void addConnection(int socketDescriptor);
+
+    // Takes effect at once, idle workers above 'count' quit, busy ones when
+    // their connection is finished.
+    void setMaxThreadCount(int count);
+    int maxThreadCount() const;
+
+    int queueDepth() const;
+    int activeWorkerCount() const;
+
+private:
+    friend class SendFileThread;
+
+    // Called by workers, block until a connection is available, return -1
+    // when pool is shutting down. 'peer' is set to the key of its peer.
+    int takeConnection(QString *peer);
+    // Called by workers before closing a connection from takeConnection().
+    void finishConnection(int socketDescriptor, const QString &peer);
+
+    QString peerKey(int socketDescriptor) const;
+    void startWorkerNotLock();
+    void reapRetiredNotLock();
+
+    mutable QMutex m_lock;
+    QWaitCondition m_cond;
+
+    QList<SendFileThread *> m_threads;
+    // quit above max thread count, deleted once finished
+    QList<SendFileThread *> m_retiredThreads;
+    int m_maxThreadCount;
+    int m_idleCount;
+    int m_activeCount;
+    int m_queueDepth;
+    bool m_isQuit;
+
+    // peers which have queued connections, in round robin order
+    QList<QString> m_peerOrder;
+    QMap<QString, QQueue<int> > m_pendingMap;
+    QMap<QString, int> m_activePerPeer;
+    // connections being served, shut down to unblock workers on quit
+    QSet<int> m_activeSockets;
+};
+
+#endif // !SEND_FILE_THREAD_POOL_H
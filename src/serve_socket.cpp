@@ -20,37 +20,49 @@
 #include "send_file_map.h"
 #include "send_file_manager.h"
 #include "global.h"
+#include "dir_walker.h"
 
-#include <QDir>
-#include <QDateTime>
+#include <QFile>
 #include <QTextCodec>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <string.h>
+#include <stdio.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#endif
 
 #define REQUST_FILE_PACKET_ID_POSITION      5
 #define REQUST_FILE_FILE_ID_POSITION        6
 #define REQUST_FILE_OFFSET_POSITION         7
+// Optional, qipmsg extension for segmented download, send only 'length'
+// bytes from offset instead of to the end of file.
+#define REQUST_FILE_LENGTH_POSITION         8
 #define MAXBUFF                             8192
 
 #define BLOCK_SIZE                          1024*16
-
-struct RequsetFile
-{
-    bool isFileSended;
-    int fileType;
-    QString filePath;
-    qint64 offset;
-    int fileId;
-};
+// Max bytes handed to sendfile() in one call, keep it bounded so that a
+// stopped client is noticed in reasonable time.
+#define SENDFILE_CHUNK_SIZE                 1024*1024*4
 
 ServeSocket::ServeSocket(int socketDescriptor, QObject *parent)
-    : QObject(parent)
+    : QObject(parent), m_ioState(ReadRequest), m_pendingPos(0), m_fileFd(-1),
+    m_fileOffset(0), m_fileEnd(0), m_dirWalker(0), m_isDirWalkEnd(false)
 {
   m_sockfd = socketDescriptor;
+  m_requestFile.isFileSended = false;
+  m_requestFile.fileId = -1;
+  m_requestFile.length = -1;
+  m_packetNo = 0;
+
+  // Reserve so that resize() in constructHeaderBlock() reuse the buffer.
+  m_headerBlock.reserve(MAXBUFF);
+  m_pendingBlock.reserve(BLOCK_SIZE);
 #if 0
     connect(&m_tcpSocket, SIGNAL(bytesWritten(qint64)),
             this, SLOT(updateBytesWrited(qint64)));
@@ -60,6 +72,10 @@ ServeSocket::ServeSocket(int socketDescriptor, QObject *parent)
 }
 ServeSocket::~ServeSocket()
 {
+  if ( m_fileFd != -1 ) {
+    close( m_fileFd );
+  }
+  delete m_dirWalker;
   close( m_sockfd );
 }
 
@@ -126,16 +142,37 @@ bool ServeSocket::handleRequest(const QByteArray &requestPacket)
 {
     qDebug() << "ServeSocket::handleRequest";
 
-    struct RequsetFile requestFile;
-    parseRequestPacket(requestPacket, requestFile);
+    if (!beginRequest(requestPacket)) {
+        return false;
+    }
+
+    bool ok;
+    if (m_requestFile.fileType == IPMSG_FILE_REGULAR) {
+        ok = tcpSendFile(m_requestFile.filePath, m_requestFile.offset,
+                         m_requestFile.length);
+    } else if (m_requestFile.fileType == IPMSG_FILE_DIR) {
+        ok = tcpSendDir(m_requestFile.filePath);
+    } else {
+        // unsupported type
+        ok = false;
+    }
+
+    endRequest(ok);
+
+    return ok;
+}
+
+bool ServeSocket::beginRequest(const QByteArray &requestPacket)
+{
+    parseRequestPacket(requestPacket, m_requestFile);
 
     SendFileMap *map = 0;
     Global::sendFileManager->m_lock.lock();
-    map = Global::sendFileManager->transferFileMap.value(m_packetNoString);
+    map = Global::sendFileManager->transferFileMap.value(m_packetNo);
     if (map) {
         map->setState(SendFileMap::Transfer);
         Global::sendFileManager
-            ->transferFileModel.updateTransfer(m_packetNoString);
+            ->transferFileModel.updateTransfer(m_packetNo);
     } else {
         Global::sendFileManager->m_lock.unlock();
         return false;
@@ -143,39 +180,47 @@ bool ServeSocket::handleRequest(const QByteArray &requestPacket)
     map->sem.release();
     Global::sendFileManager->m_lock.unlock();
 
-    if (!requestFile.isFileSended) {
+    if (!m_requestFile.isFileSended) {
         m_errorString = "ServeSocket::handleRequest: Request file not sended";
-        goto handle_request_fail;
+        endRequest(false);
+        return false;
     }
 
-    if (requestFile.fileType == IPMSG_FILE_REGULAR) {
-        if (!tcpSendFile(requestFile.filePath, requestFile.offset)) {
-            goto handle_request_fail;
-        }
-    } else if (requestFile.fileType == IPMSG_FILE_DIR) {
-        if (!tcpSendDir(requestFile.filePath)) {
-            goto handle_request_fail;
+    return true;
+}
+
+void ServeSocket::endRequest(bool ok)
+{
+    SendFileMap *map = 0;
+
+    if (ok) {
+        Global::sendFileManager->m_lock.lock();
+        map = Global::sendFileManager->transferFileMap.value(m_packetNo);
+        int fileId = m_requestFile.fileId;
+        bool hasFile = map && map->fileSet().contains(fileId);
+        // A segment only finish the file when all segments are sended.
+        if (hasFile && m_requestFile.length >= 0
+            && map->addSegmentSended(fileId, m_requestFile.length)
+               < map->fileSize(fileId)) {
+            map->setState(SendFileMap::NotTransfer);
+            Global::sendFileManager
+                ->transferFileModel.updateTransfer(m_packetNo);
+        } else if (hasFile) {
+            map->setFileState(fileId, SendFile::SendOk);
+            map->incrTransferCount();
+            map->setState(SendFileMap::NotTransfer);
+            Global::sendFileManager
+                ->transferFileModel.updateTransfer(m_packetNo);
+            // if transfer finished, delete transfer
+            if (map->isFinished()) {
+                Global::sendFileManager->removeTransfer(m_packetNo);
+            }
         }
-    } else {
-        // unsupported type
-        goto handle_request_fail;
-    }
+        Global::sendFileManager->m_lock.unlock();
 
-    Global::sendFileManager->m_lock.lock();
-    map->m_map[requestFile.fileId]->setState(SendFile::SendOk);
-    map->incrTransferCount();
-    map->setState(SendFileMap::NotTransfer);
-    Global::sendFileManager
-        ->transferFileModel.updateTransfer(m_packetNoString);
-    // if transfer finished, delete transfer
-    if (map->isFinished()) {
-        Global::sendFileManager->removeTransfer(m_packetNoString);
+        return;
     }
-    Global::sendFileManager->m_lock.unlock();
 
-    return true;
-
-handle_request_fail:
     qDebug() << "ServeSocket::handleRequest: send file error";
 
     // when this error happed, the file may have finished transfer by a
@@ -184,20 +229,20 @@ handle_request_fail:
     // we user handle class, so we can not test if recvFileHandle is bounded
     // how to test if a handle class is bounded????????????????
     Global::sendFileManager->m_lock.lock();
-    map = Global::sendFileManager->transferFileMap.value(m_packetNoString);
+    map = Global::sendFileManager->transferFileMap.value(m_packetNo);
     if (map) {
         qDebug() << "sem.available:" << map->sem.available();
         if (map->sem.available() == 1) {
             map->setState(SendFileMap::NotTransfer);
             Global::sendFileManager
-                ->transferFileModel.updateTransfer(m_packetNoString);
-            map->m_map[requestFile.fileId]->setState(SendFile::SendFail);
+                ->transferFileModel.updateTransfer(m_packetNo);
+            if (map->fileSet().contains(m_requestFile.fileId)) {
+                map->setFileState(m_requestFile.fileId, SendFile::SendFail);
+            }
         }
         map->sem.acquire();
     }
     Global::sendFileManager->m_lock.unlock();
-
-    return false;
 }
 
 void ServeSocket::parseRequestPacket(const QByteArray &requestPacket,
@@ -208,55 +253,137 @@ void ServeSocket::parseRequestPacket(const QByteArray &requestPacket,
     // XXX NOTE: canParsePacket() make sure we have enough items in list,
     // so we do not need to check size of list before call list.at()
     bool ok;
-    long id = list.at(REQUST_FILE_PACKET_ID_POSITION).toLong(&ok, 16);
-    m_packetNoString = QString("%1").arg(id);
+    m_packetNo = list.at(REQUST_FILE_PACKET_ID_POSITION).toLongLong(&ok, 16);
     int fileId = list.at(REQUST_FILE_FILE_ID_POSITION).toLong(&ok, 16);
     int command = list.at(MSG_FLAGS_POS).toInt(&ok, 16);
 
     QMutexLocker locker(&Global::sendFileManager->m_lock);
 
     SendFileMap *sendFileMap
-        = Global::sendFileManager->transferFileMap.value(m_packetNoString);
+        = Global::sendFileManager->transferFileMap.value(m_packetNo);
     requestFile.isFileSended = false;
     if (sendFileMap && sendFileMap->canSendFile(fileId)) {
         requestFile.isFileSended = true;
-        requestFile.fileType = sendFileMap->m_map[fileId]->type();
-        requestFile.filePath = sendFileMap->m_map[fileId]->absoluteFilePath();
+        requestFile.fileType = sendFileMap->fileType(fileId);
+        requestFile.filePath = sendFileMap->filePath(fileId);
         requestFile.fileId = fileId;
+        requestFile.length = -1;
         if (command == IPMSG_GETFILEDATA) {
             requestFile.offset
                 = list.at(REQUST_FILE_OFFSET_POSITION).toLongLong(&ok, 16);
+            if (list.size() > REQUST_FILE_LENGTH_POSITION
+                && !list.at(REQUST_FILE_LENGTH_POSITION).isEmpty()) {
+                qint64 length
+                    = list.at(REQUST_FILE_LENGTH_POSITION).toLongLong(&ok, 16);
+                if (ok) {
+                    requestFile.length = length;
+                }
+            }
         } else {
             requestFile.offset = 0;
         }
     }
 }
 
-bool ServeSocket::tcpSendFile(QString filePath, qint64 offset)
+bool ServeSocket::tcpSendFile(QString filePath, qint64 offset, qint64 length)
 {
-    QFile file(filePath);
+    int fd = open(QFile::encodeName(filePath).constData(), O_RDONLY);
+    if (fd == -1) {
+        m_errorString = strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    bool ok = false;
+    if (fstat(fd, &st) == -1) {
+        m_errorString = strerror(errno);
+    } else {
+        qint64 end = st.st_size;
+        if (length >= 0) {
+            end = qMin(end, offset + length);
+        }
+        ok = tcpSendFileData(fd, offset, end);
+    }
+    close(fd);
+
+    return ok;
+}
 
-    if (!file.open(QIODevice::ReadOnly)) {
+bool ServeSocket::tcpSendFileData(int fd, qint64 offset, qint64 end)
+{
+    // Let kernel copy file data to socket directly, 'offset' is advanced by
+    // bytes sended. If file system not support it, we go on with the
+    // read and send loop from where it stopped.
+    if (!tcpSendFileZeroCopy(fd, offset, end)) {
         return false;
     }
 
-    file.seek(offset);
-    while (!file.atEnd()) {
-        QByteArray block = file.read(BLOCK_SIZE);
-        if (!tcpWriteBlock(block)) {
+    char block[BLOCK_SIZE];
+    while (offset < end) {
+        ssize_t n = pread(fd, block, qMin(end - offset, (qint64)sizeof(block)),
+                          offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            m_errorString = strerror(errno);
+            return false;
+        }
+        if (n == 0) {
+            // File shrinked after its size was announced, the receiver
+            // would take the rest of stream as file data.
+            m_errorString = "file truncated while sending";
+            return false;
+        }
+        if (!tcpWriteBlock(block, n)) {
+            return false;
+        }
+        offset += n;
+    }
+
+    return true;
+}
+
+bool ServeSocket::tcpSendFileZeroCopy(int fd, qint64 &offset, qint64 end)
+{
+#ifdef Q_OS_LINUX
+    while (offset < end) {
+        off_t off = offset;
+        size_t count = qMin(end - offset, (qint64)SENDFILE_CHUNK_SIZE);
+        ssize_t n = sendfile(m_sockfd, fd, &off, count);
+        if (n > 0) {
+            offset += n;
+        } else if (n == 0) {
+            m_errorString = "file truncated while sending";
+            return false;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EINVAL || errno == ENOSYS) {
+            // sendfile() not supported by this file, caller fall back to
+            // read and send.
+            break;
+        } else {
+            m_errorString = strerror(errno);
             return false;
         }
     }
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(offset);
+    Q_UNUSED(end);
+#endif
 
     return true;
 }
 
 bool ServeSocket::tcpWriteBlock(QByteArray &block)
 {
-  size_t  nbytes = block.size();
-  char*   buff   = block.data();
+  return tcpWriteBlock(block.constData(), block.size());
+}
 
-  size_t  sent = 0;
+bool ServeSocket::tcpWriteBlock(const char *buff, qint64 nbytes)
+{
+  qint64  sent = 0;
   ssize_t n    = 0;
   while ( sent < nbytes ) {
     n = send(m_sockfd, buff+sent, nbytes-sent, 0);
@@ -293,116 +420,301 @@ bool ServeSocket::tcpWriteBlock(QByteArray &block)
 
 bool ServeSocket::tcpSendDir(QString filePath)
 {
-    QByteArray dirBlock = constructDirSendBlock(filePath, NormalBlockMode);
-    if (!tcpWriteBlock(dirBlock)) {
-        return false;
+    DirWalker walker(filePath);
+
+    forever {
+        switch (walker.next()) {
+        case DirWalker::EnterDir:
+            constructHeaderBlock(m_headerBlock, walker, IPMSG_FILE_DIR);
+            if (!tcpWriteBlock(m_headerBlock)) {
+                return false;
+            }
+            break;
+
+        case DirWalker::LeaveDir:
+            constructHeaderBlock(m_headerBlock, walker, IPMSG_FILE_RETPARENT);
+            if (!tcpWriteBlock(m_headerBlock)) {
+                return false;
+            }
+            break;
+
+        case DirWalker::RegularFile:
+        {
+            constructHeaderBlock(m_headerBlock, walker, IPMSG_FILE_REGULAR);
+            if (!tcpWriteBlock(m_headerBlock)) {
+                return false;
+            }
+            int fd = walker.openFile();
+            if (fd == -1) {
+                m_errorString = walker.errorString();
+                return false;
+            }
+            bool ok = tcpSendFileData(fd, 0, walker.size());
+            close(fd);
+            if (!ok) {
+                return false;
+            }
+            break;
+        }
+
+        case DirWalker::End:
+            return true;
+
+        case DirWalker::Error:
+            m_errorString = walker.errorString();
+            return false;
+        }
+    }
+}
+
+// Header of each entry in directory transfer, 'block' is reused between
+// calls to avoid allocation:
+// header-size:filename:file-size:fileattr:[[extend-attr=val1[,val2...]]:]
+void ServeSocket::constructHeaderBlock(QByteArray &block,
+        const DirWalker &walker, int fileType) const
+{
+    block.resize(TRANSFER_FILE_HEADER_SIZE_LENGTH);
+    block.append(':');
+
+    // Only convert file name when transfer codec differs from local one.
+    QTextCodec *codec = Global::transferCodec->codec();
+    if (codec == QTextCodec::codecForLocale()) {
+        block.append(walker.name());
+    } else {
+        block.append(codec->fromUnicode(QFile::decodeName(walker.name())));
     }
 
-    QDir dir(filePath);
-    QFileInfoList fileInfoList = dir.entryInfoList();
+    char buf[128];
+    int n = snprintf(buf, sizeof(buf), ":%0*llx:%x:%x=%llx:%x=%llx:",
+            TRANSFER_FILE_FILE_SIZE_LENGTH,
+            (unsigned long long)walker.size(), fileType,
+            IPMSG_FILE_MTIME, (unsigned long long)walker.lastModified(),
+            IPMSG_FILE_CREATETIME, (unsigned long long)walker.created());
+    block.append(buf, n);
+
+    snprintf(buf, sizeof(buf), "%0*x", TRANSFER_FILE_HEADER_SIZE_LENGTH,
+             block.size());
+    memcpy(block.data(), buf, TRANSFER_FILE_HEADER_SIZE_LENGTH);
+}
 
-    foreach (QFileInfo fi, fileInfoList) {
-        // Skip '.' and '..' directory
-        if (fi.fileName() == "." || fi.fileName() == "..") {
+bool ServeSocket::readRequest()
+{
+    char buff[MAXBUFF];
+
+    forever {
+        ssize_t n = read(m_sockfd, buff, MAXBUFF);
+        if (n > 0) {
+            m_recvBlock.append(buff, n);
+            if (canParsePacket(m_recvBlock)) {
+                break;
+            }
+        } else if (n < 0 && errno == EINTR) {
             continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // wait for more data
+            return true;
+        } else {
+            return false;
         }
+    }
 
-        if (fi.isFile()) {
-            QByteArray fileBlock
-                = constructFileSendBlock(fi.absoluteFilePath());
-            if (!tcpWriteBlock(fileBlock)) {
+    if (!beginRequest(m_recvBlock)) {
+        return false;
+    }
+    m_recvBlock.clear();
+
+    bool ok;
+    if (m_requestFile.fileType == IPMSG_FILE_REGULAR) {
+        ok = openSendFile(m_requestFile.filePath, m_requestFile.offset,
+                          m_requestFile.length);
+    } else if (m_requestFile.fileType == IPMSG_FILE_DIR) {
+        m_dirWalker = new DirWalker(m_requestFile.filePath);
+        ok = true;
+    } else {
+        // unsupported type
+        ok = false;
+    }
+
+    if (!ok) {
+        endRequest(false);
+        return false;
+    }
+
+    m_ioState = SendData;
+
+    return true;
+}
+
+bool ServeSocket::writeData()
+{
+    forever {
+        // Header block or data read by fallback path go first.
+        while (m_pendingPos < m_pendingBlock.size()) {
+            ssize_t n = send(m_sockfd, m_pendingBlock.constData() + m_pendingPos,
+                             m_pendingBlock.size() - m_pendingPos, MSG_NOSIGNAL);
+            if (n > 0) {
+                m_pendingPos += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            } else {
+                abortRequest();
                 return false;
             }
-            if (!tcpSendFile(fi.absoluteFilePath(), 0)) {
-                return false;
+        }
+        m_pendingBlock.resize(0);
+        m_pendingPos = 0;
+
+        if (m_fileFd != -1) {
+            if (m_fileOffset < m_fileEnd) {
+                bool wouldBlock = false;
+                if (!sendFileChunk(wouldBlock)) {
+                    abortRequest();
+                    return false;
+                }
+                if (wouldBlock) {
+                    return true;
+                }
+                continue;
             }
+            close(m_fileFd);
+            m_fileFd = -1;
         }
-        if (fi.isDir()) {
-            if (!tcpSendDir(fi.absoluteFilePath())) {
+
+        if (m_dirWalker && !m_isDirWalkEnd) {
+            if (!nextDirBlock()) {
+                abortRequest();
                 return false;
             }
+            continue;
         }
+
+        endRequest(true);
+        m_ioState = Finished;
+
+        return true;
     }
+}
 
-    QByteArray retParentBlock
-        = constructDirSendBlock(filePath, RetParentBlockMode);
-    if (!tcpWriteBlock(retParentBlock)) {
+void ServeSocket::abortRequest()
+{
+    if (m_ioState == SendData) {
+        endRequest(false);
+    }
+    m_ioState = Finished;
+}
+
+bool ServeSocket::openSendFile(QString filePath, qint64 offset,
+                               qint64 length)
+{
+    int fd = open(QFile::encodeName(filePath).constData(), O_RDONLY);
+    if (fd == -1) {
+        m_errorString = strerror(errno);
         return false;
     }
 
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        m_errorString = strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    m_fileFd = fd;
+    m_fileOffset = offset;
+    m_fileEnd = st.st_size;
+    if (length >= 0) {
+        m_fileEnd = qMin(m_fileEnd, offset + length);
+    }
+
     return true;
 }
 
-QByteArray ServeSocket::constructDirSendBlock(QString filePath,
-        DirBlockModes mode)
+bool ServeSocket::sendFileChunk(bool &wouldBlock)
 {
-    QFileInfo fi(filePath);
-
-    QString fileName;
-    if (mode == NormalBlockMode) {
-        fileName = fi.fileName();
-        // If send directory is root directory, we change its name to
-        // "(root-directory)"
-        if (fileName == "/") {
-            fileName = "(root-directory)";
-        }
-    } else if (mode == RetParentBlockMode) {
-        fileName = ".";
+    qint64 count = qMin(m_fileEnd - m_fileOffset, (qint64)SENDFILE_CHUNK_SIZE);
+
+#ifdef Q_OS_LINUX
+    off_t off = m_fileOffset;
+    ssize_t n = sendfile(m_sockfd, m_fileFd, &off, count);
+    if (n > 0) {
+        m_fileOffset += n;
+        return true;
+    } else if (n == 0) {
+        // File shrinked after its size was announced, the receiver would
+        // take the rest of stream as file data.
+        m_errorString = "file truncated while sending";
+        return false;
+    } else if (errno == EINTR) {
+        return true;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        wouldBlock = true;
+        return true;
+    } else if (errno != EINVAL && errno != ENOSYS) {
+        m_errorString = strerror(errno);
+        return false;
     }
+#endif
 
-    QString str(":");
-    str.append(fileName);
-    str.append(":");
-    str.append(QString("%1").arg(0, TRANSFER_FILE_FILE_SIZE_LENGTH, 16, QChar('0')));
-    str.append(":");
-    if (mode == RetParentBlockMode) {
-        str.append(QString("%1").arg(IPMSG_FILE_RETPARENT, 0, 16));
-    } else if (mode == NormalBlockMode) {
-        str.append(QString("%1").arg(IPMSG_FILE_DIR, 0, 16));
+    // sendfile() not supported by this file, read a block and let the
+    // pending block path send it.
+    m_pendingBlock.resize(qMin(count, (qint64)BLOCK_SIZE));
+    ssize_t r = pread(m_fileFd, m_pendingBlock.data(), m_pendingBlock.size(),
+                      m_fileOffset);
+    if (r < 0) {
+        m_pendingBlock.resize(0);
+        if (errno == EINTR) {
+            return true;
+        }
+        m_errorString = strerror(errno);
+        return false;
+    }
+    if (r == 0) {
+        m_pendingBlock.resize(0);
+        m_errorString = "file truncated while sending";
+        return false;
     }
-    str.append(":");
-    str.append(QString("%1=%2").arg(IPMSG_FILE_MTIME, 0, 16)
-            .arg(fi.lastModified().toTime_t(), 0, 16));
-    str.append(":");
-    str.append(QString("%1=%2").arg(IPMSG_FILE_CREATETIME, 0, 16)
-            .arg(fi.created().toTime_t(), 0, 16));
-    str.append(":");
-
-    QByteArray block = Global::transferCodec->codec()->fromUnicode(str);
-    QString s = QString("%1").arg(block.size() + TRANSFER_FILE_HEADER_SIZE_LENGTH,
-            TRANSFER_FILE_HEADER_SIZE_LENGTH, 16, QChar('0'));
-
-    QByteArray ba = Global::transferCodec->codec()->fromUnicode(s);
-    return ba + block;
+    m_pendingBlock.resize(r);
+    m_pendingPos = 0;
+    m_fileOffset += r;
+
+    return true;
 }
 
-QByteArray ServeSocket::constructFileSendBlock(QString filePath) const
+// Prepare next header block of directory transfer, and open file for
+// sending its content if it is a regular file.
+bool ServeSocket::nextDirBlock()
 {
-    QFileInfo fi(filePath);
-
-    QString fileName;
-    fileName = fi.fileName();
-
-    QString str(":");
-    str.append(fileName);
-    str.append(":");
-    str.append(QString("%1").arg(fi.size(), TRANSFER_FILE_FILE_SIZE_LENGTH,
-                16, QChar('0')));
-    str.append(":");
-    str.append(QString("%1").arg(IPMSG_FILE_REGULAR, 0, 16));
-    str.append(":");
-    str.append(QString("%1=%2").arg(IPMSG_FILE_MTIME, 0, 16)
-            .arg(fi.lastModified().toTime_t(), 0, 16));
-    str.append(":");
-    str.append(QString("%1=%2").arg(IPMSG_FILE_CREATETIME, 0, 16)
-            .arg(fi.created().toTime_t(), 0, 16));
-    str.append(":");
-
-    QByteArray block = Global::transferCodec->codec()->fromUnicode(str);
-    QString s = QString("%1").arg(block.size() + TRANSFER_FILE_HEADER_SIZE_LENGTH,
-            TRANSFER_FILE_HEADER_SIZE_LENGTH, 16, QChar('0'));
-
-    QByteArray ba = Global::transferCodec->codec()->fromUnicode(s);
-    return ba + block;
-}
+    switch (m_dirWalker->next()) {
+    case DirWalker::EnterDir:
+        constructHeaderBlock(m_pendingBlock, *m_dirWalker, IPMSG_FILE_DIR);
+        return true;
+
+    case DirWalker::LeaveDir:
+        constructHeaderBlock(m_pendingBlock, *m_dirWalker,
+                             IPMSG_FILE_RETPARENT);
+        return true;
+
+    case DirWalker::RegularFile:
+        constructHeaderBlock(m_pendingBlock, *m_dirWalker, IPMSG_FILE_REGULAR);
+        m_fileFd = m_dirWalker->openFile();
+        if (m_fileFd == -1) {
+            m_errorString = m_dirWalker->errorString();
+            return false;
+        }
+        m_fileOffset = 0;
+        m_fileEnd = m_dirWalker->size();
+        return true;
 
+    case DirWalker::End:
+        m_isDirWalkEnd = true;
+        return true;
+
+    case DirWalker::Error:
+        m_errorString = m_dirWalker->errorString();
+        return false;
+    }
+
+    return false;
+}
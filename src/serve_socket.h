@@ -21,7 +21,17 @@
 #include <QTcpSocket>
 
 
-struct RequsetFile;
+class DirWalker;
+
+struct RequsetFile
+{
+    bool isFileSended;
+    int fileType;
+    QString filePath;
+    qint64 offset;
+    qint64 length;          // -1 means to the end of file
+    int fileId;
+};
 
 
 class ServeSocket : public QObject
@@ -29,29 +39,60 @@ class ServeSocket : public QObject
     Q_OBJECT;
 
 public:
-    enum DirBlockModes {
-        NormalBlockMode,
-        RetParentBlockMode
-    };
+    enum IoStates { ReadRequest, SendData, Finished };
 
     ServeSocket(int socketDescriptor, QObject *parent = 0);
     ~ServeSocket();
 
+    // Blocking mode, serve the whole request in caller's thread.
     bool startSendFile();
 
+    // Non-blocking mode used by SendFileEventLoop, socket must be set
+    // O_NONBLOCK. These return false if connection should be closed, and
+    // ioState() tell which readiness to wait next.
+    bool readRequest();
+    bool writeData();
+    void abortRequest();
+    IoStates ioState() const { return m_ioState; }
+
+    int socketDescriptor() const { return m_sockfd; }
+
 private:
     bool canParsePacket(const QByteArray &requestPacket) const;
     bool handleRequest(const QByteArray &requestPacket);
+    bool beginRequest(const QByteArray &requestPacket);
+    void endRequest(bool ok);
     void parseRequestPacket(const QByteArray&, struct RequsetFile&);
-    bool tcpSendFile(QString filePath, qint64 offset);
+    bool tcpSendFile(QString filePath, qint64 offset, qint64 length);
+    bool tcpSendFileData(int fd, qint64 offset, qint64 end);
+    bool tcpSendFileZeroCopy(int fd, qint64 &offset, qint64 end);
     bool tcpSendDir(QString filePath);
     bool tcpWriteBlock(QByteArray &block);
-    QByteArray constructDirSendBlock(QString filePath, DirBlockModes mode);
-    QByteArray constructFileSendBlock(QString filePath) const;
+    bool tcpWriteBlock(const char *buff, qint64 nbytes);
+    void constructHeaderBlock(QByteArray &block, const DirWalker &walker,
+                              int fileType) const;
+
+    bool openSendFile(QString filePath, qint64 offset, qint64 length = -1);
+    bool sendFileChunk(bool &wouldBlock);
+    bool nextDirBlock();
 
     QString m_errorString;
-    QString m_packetNoString;
+    qint64 m_packetNo;
     int     m_sockfd;
+
+    struct RequsetFile m_requestFile;
+    QByteArray m_headerBlock;
+
+    // Non-blocking mode states
+    IoStates m_ioState;
+    QByteArray m_recvBlock;
+    QByteArray m_pendingBlock;
+    int m_pendingPos;
+    int m_fileFd;
+    qint64 m_fileOffset;
+    qint64 m_fileEnd;
+    DirWalker *m_dirWalker;
+    bool m_isDirWalkEnd;
 };
 
 #endif // !SERVE_SOCKET_H
@@ -19,6 +19,8 @@
 #include "setup_window.h"
 #include "user_manager.h"
 #include "transfer_codec.h"
+#include "file_server.h"
+#include "constants.h"
 
 #include <QtGui>
 #include <QtCore>
@@ -127,9 +129,41 @@ TransferTab::TransferTab(QWidget *parent)
 
     QLabel *label = new QLabel(tr("Transfer Codec:"));
 
+    QLabel *sendFileThreadLabel = new QLabel(tr("Max send file threads:"));
+    sendFileThreadSpinBox = new QSpinBox;
+    sendFileThreadSpinBox->setRange(1, 64);
+    sendFileThreadSpinBox->setValue(Global::preferences->maxSendFileThreadCount);
+
+    QLabel *recvFileConnectionLabel
+        = new QLabel(tr("Receive files in parallel:"));
+    recvFileConnectionSpinBox = new QSpinBox;
+    recvFileConnectionSpinBox->setRange(1, 16);
+    recvFileConnectionSpinBox
+        ->setValue(Global::preferences->maxRecvFileConnectionCount);
+
+    QLabel *recvFileSegmentLabel
+        = new QLabel(tr("Connections per large file:"));
+    recvFileSegmentSpinBox = new QSpinBox;
+    recvFileSegmentSpinBox->setRange(1, 16);
+    recvFileSegmentSpinBox
+        ->setValue(Global::preferences->recvFileSegmentCount);
+
+    eventDrivenFileServerCheckBox
+        = new QCheckBox(tr("Serve files with event loops (need restart)"));
+    if (Global::preferences->isEventDrivenFileServer) {
+        eventDrivenFileServerCheckBox->setCheckState(Qt::Checked);
+    }
+
     QGridLayout *mainLayout = new QGridLayout;
     mainLayout->addWidget(label, 0, 0);
     mainLayout->addWidget(codecComboBox, 0, 1);
+    mainLayout->addWidget(sendFileThreadLabel, 1, 0);
+    mainLayout->addWidget(sendFileThreadSpinBox, 1, 1);
+    mainLayout->addWidget(recvFileConnectionLabel, 2, 0);
+    mainLayout->addWidget(recvFileConnectionSpinBox, 2, 1);
+    mainLayout->addWidget(recvFileSegmentLabel, 3, 0);
+    mainLayout->addWidget(recvFileSegmentSpinBox, 3, 1);
+    mainLayout->addWidget(eventDrivenFileServerCheckBox, 4, 0, 1, 2);
 
     mainLayout->setColumnStretch(0, 10);
     mainLayout->setColumnStretch(1, 30);
@@ -178,6 +212,17 @@ void TransferTab::save()
 {
     Global::preferences->transferCodecName = codecComboBox->currentText();
     Global::transferCodec->setTransCodec(codecComboBox->currentText());
+
+    Global::preferences->maxSendFileThreadCount
+        = sendFileThreadSpinBox->value();
+    Global::fileServer->setMaxThreadCount(
+            Global::preferences->maxSendFileThreadCount);
+    Global::preferences->isEventDrivenFileServer
+        = eventDrivenFileServerCheckBox->isChecked();
+    Global::preferences->maxRecvFileConnectionCount
+        = recvFileConnectionSpinBox->value();
+    Global::preferences->recvFileSegmentCount
+        = recvFileSegmentSpinBox->value();
 }
 
 void LogTab::getLogFilePath()
@@ -347,6 +392,7 @@ SetupWindow::SetupWindow(QWidget *parent)
     createGroupNameGroupBox();
     createSendRecvSettingsGroupBox();
     createBroadcastGroupBox();
+    createMulticastGroupBox();
 
     createButtonLayout();
 
@@ -359,7 +405,8 @@ SetupWindow::SetupWindow(QWidget *parent)
     mainLayout->addWidget(sendReceiveSettingsGroupBox, 1, 0, 1, 1);
     mainLayout->addWidget(miscSettingGroupBox, 1, 1);
     mainLayout->addWidget(broadcastGroupBox, 2, 0, 1, 2);
-    mainLayout->addLayout(buttonsLayout, 3, 0, 1, 2);
+    mainLayout->addWidget(multicastGroupBox, 3, 0, 1, 2);
+    mainLayout->addLayout(buttonsLayout, 4, 0, 1, 2);
 
     createConnections();
 
@@ -463,6 +510,8 @@ void SetupWindow::createBroadcastGroupBox()
     line_edit_ = new QLineEdit;
     QCheckBox* dial_up = new QCheckBox(tr("dial up connection"));
     dial_up->setEnabled(false);
+    listServerCheck = new QCheckBox(tr("Serve user list to other hosts"));
+    listServerCheck->setChecked(Global::preferences->isListServer);
 
     QPushButton* add_button = new QPushButton(">>");
     QPushButton* del_button = new QPushButton("<<");
@@ -481,12 +530,38 @@ void SetupWindow::createBroadcastGroupBox()
     grid_layout->addWidget(label, 0, 0, 1, 1);
     grid_layout->addWidget(line_edit_, 1, 0, 1, 1);
     grid_layout->addWidget(dial_up, 2, 0, 1, 1);
-    grid_layout->addLayout(button_layout, 0, 1, 3, 1);
-    grid_layout->addWidget(broadcast_list_widget_, 0, 2, 3, 1);
+    grid_layout->addWidget(listServerCheck, 3, 0, 1, 1);
+    grid_layout->addLayout(button_layout, 0, 1, 4, 1);
+    grid_layout->addWidget(broadcast_list_widget_, 0, 2, 4, 1);
 
     broadcastGroupBox->setLayout(grid_layout);
 }
 
+void SetupWindow::createMulticastGroupBox()
+{
+    multicastGroupBox = new QGroupBox(tr("Multicast Discovery"));
+    multicastGroupBox->setCheckable(true);
+    multicastGroupBox->setChecked(Global::preferences->isMulticastDiscovery);
+
+    QLabel *groupLabel = new QLabel(tr("Group address"));
+    multicastGroupEdit = new QLineEdit;
+    multicastGroupEdit->setText(Global::preferences->multicastGroup);
+
+    QLabel *interfaceLabel
+        = new QLabel(tr("Interface ip (blank for all, others broadcast)"));
+    multicastInterfaceEdit = new QLineEdit;
+    multicastInterfaceEdit->setText(
+            Global::preferences->multicastInterfaceList.join(" "));
+
+    QGridLayout *grid_layout = new QGridLayout();
+    grid_layout->addWidget(groupLabel, 0, 0);
+    grid_layout->addWidget(multicastGroupEdit, 0, 1);
+    grid_layout->addWidget(interfaceLabel, 1, 0);
+    grid_layout->addWidget(multicastInterfaceEdit, 1, 1);
+
+    multicastGroupBox->setLayout(grid_layout);
+}
+
 void SetupWindow::createButtonLayout()
 {
     okButton = new QPushButton(tr("Ok"));
@@ -567,6 +642,17 @@ void SetupWindow::applyPreferences()
     Global::preferences->isQuoteMsg = quoteMsg->isChecked();
     Global::preferences->isNoAutoPopupMsg = noAutoPopupMsg->isChecked();
 
+    Global::preferences->isListServer = listServerCheck->isChecked();
+
+    Global::preferences->isMulticastDiscovery
+        = multicastGroupBox->isChecked();
+    QString group = multicastGroupEdit->text().trimmed();
+    Global::preferences->multicastGroup
+        = group.isEmpty() ? QString(MULTICAST_DEFAULT_GROUP) : group;
+    Global::preferences->multicastInterfaceList
+        = multicastInterfaceEdit->text().split(QRegExp("[\\s,;]+"),
+                                               QString::SkipEmptyParts);
+
     Global::userManager->updateOurself();
     Global::userManager->broadcastEntry();
 
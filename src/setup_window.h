@@ -28,6 +28,7 @@ class QLabel;
 class QLineEdit;
 class QPushButton;
 class QSize;
+class QSpinBox;
 class QTabWidget;
 class QWidget;
 
@@ -107,6 +108,10 @@ private:
 
     QComboBox *codecComboBox;
     QLabel *codecLabel;
+    QSpinBox *sendFileThreadSpinBox;
+    QCheckBox *eventDrivenFileServerCheckBox;
+    QSpinBox *recvFileConnectionSpinBox;
+    QSpinBox *recvFileSegmentSpinBox;
 };
 
 class DetailSetupDialog : public QDialog
@@ -159,6 +164,7 @@ private:
     void createSendRecvSettingsGroupBox();
     void createMiscSettingGroupBox();
     void createBroadcastGroupBox();
+    void createMulticastGroupBox();
 
     void createButtonLayout();
 
@@ -169,6 +175,7 @@ private:
     QGroupBox *sendReceiveSettingsGroupBox;
     QGroupBox *miscSettingGroupBox;
     QGroupBox *broadcastGroupBox;
+    QGroupBox *multicastGroupBox;
 
     QPushButton *okButton;
     QPushButton *applyButton;
@@ -189,6 +196,11 @@ private:
 
     QListWidget *broadcast_list_widget_;
     QLineEdit* line_edit_;
+
+    QCheckBox *listServerCheck;
+
+    QLineEdit *multicastGroupEdit;
+    QLineEdit *multicastInterfaceEdit;
 };
 
 #endif // !SETUP_WINDOW_H
@@ -71,6 +71,11 @@ Systray::~Systray()
     trayIcon = 0;
 }
 
+void Systray::showWarning(const QString &title, const QString &text)
+{
+    trayIcon->showMessage(title, text, QSystemTrayIcon::Warning);
+}
+
 void Systray::timerEvent(QTimerEvent *event)
 {
     if (Global::windowManager->hidedMsgWindowCount() > 0) {
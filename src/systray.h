@@ -49,6 +49,9 @@ public:
     void notifyMessage(ChatWindow* pw = NULL);
     void clearNotify();
 
+    // Balloon message, does not block like a message box.
+    void showWarning(const QString &title, const QString &text);
+
 protected:
     void timerEvent(QTimerEvent *event);
 
@@ -0,0 +1,74 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(int tickInterval, int slotCount, QObject *parent)
+    : QObject(parent), m_tickInterval(tickInterval), m_slots(slotCount),
+    m_current(0), m_count(0)
+{
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+void TimerWheel::schedule(qint64 key, int msec)
+{
+    int ticks = qMax(1, (msec + m_tickInterval - 1) / m_tickInterval);
+
+    Entry entry;
+    entry.key = key;
+    entry.rounds = (ticks - 1) / m_slots.size();
+    m_slots[(m_current + ticks) % m_slots.size()] << entry;
+    ++m_count;
+
+    if (!m_timer.isActive()) {
+        m_timer.start(m_tickInterval);
+    }
+}
+
+QList<qint64> TimerWheel::takeExpired()
+{
+    QList<qint64> l;
+    l.swap(m_expired);
+    return l;
+}
+
+void TimerWheel::tick()
+{
+    m_current = (m_current + 1) % m_slots.size();
+
+    QList<Entry> &slot = m_slots[m_current];
+    bool isExpired = false;
+    for (int i = 0; i < slot.size(); ) {
+        if (slot[i].rounds == 0) {
+            m_expired << slot.at(i).key;
+            slot.removeAt(i);
+            --m_count;
+            isExpired = true;
+        } else {
+            --slot[i].rounds;
+            ++i;
+        }
+    }
+
+    // No wakeup while idle.
+    if (m_count == 0) {
+        m_timer.stop();
+    }
+
+    if (isExpired) {
+        emit expired();
+    }
+}
@@ -0,0 +1,62 @@
+// This file is part of QIpMsg.
+//
+// QIpMsg is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// QIpMsg is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with QIpMsg.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QList>
+
+// Hashed timer wheel of integer keys. Any number of deadlines cost one
+// QTimer, which only runs while some key is scheduled.
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+    TimerWheel(int tickInterval, int slotCount, QObject *parent = 0);
+
+    // Expire 'key' after 'msec' milliseconds, rounded up to ticks.
+    void schedule(qint64 key, int msec);
+
+    // Keys expired since last call.
+    QList<qint64> takeExpired();
+
+    int count() const { return m_count; }
+
+signals:
+    void expired();
+
+private slots:
+    void tick();
+
+private:
+    struct Entry {
+        qint64 key;
+        int rounds;     // full turns of wheel left
+    };
+
+    QTimer m_timer;
+    int m_tickInterval;
+    QVector<QList<Entry> > m_slots;
+    int m_current;
+    int m_count;
+    QList<qint64> m_expired;
+};
+
+#endif // !TIMER_WHEEL_H
@@ -61,21 +61,22 @@ void TransferFileModel::insertTransfer(SendFileMap *sendFileMap)
     m_model->setData(m_model->index(row, TRANSFER_FILE_VIEW_USER_COLUMN),
                      sendFileMap->recvUserInfo());
     m_model->setData(m_model->index(row, TRANSFER_FILE_VIEW_KEY_COLUMN),
-                     sendFileMap->packetNoString());
+                     sendFileMap->packetNo());
+
+    m_rows.insert(sendFileMap->packetNo(), QPersistentModelIndex(
+                  m_model->index(row, TRANSFER_FILE_VIEW_KEY_COLUMN)));
 }
 
 // XXX NOTE: caller must hold sendFileManager lock when calling this.
-void TransferFileModel::updateTransfer(QString packetNoString)
+void TransferFileModel::updateTransfer(qint64 packetNo)
 {
-    int row = keyToRow(packetNoString);
+    int row = keyToRow(packetNo);
 
     SendFileMap *map
-        = Global::sendFileManager->transferFileMap.value(packetNoString);
-#if 0
-    if (!map) {
+        = Global::sendFileManager->transferFileMap.value(packetNo);
+    if (!map || row == -1) {
         return;
     }
-#endif
 
     // Qt 4.3.5 need this statement, Qt 4.4.0 not need.
     qRegisterMetaType<QModelIndex>("QModelIndex");
@@ -92,36 +93,23 @@ void TransferFileModel::updateTransfer(QString packetNoString)
     m_model->setData(m_model->index(row, TRANSFER_FILE_VIEW_USER_COLUMN),
                      map->recvUserInfo());
     m_model->setData(m_model->index(row, TRANSFER_FILE_VIEW_KEY_COLUMN),
-                     map->packetNoString());
+                     map->packetNo());
 }
 
-int TransferFileModel::keyToRow(QString key) const
+int TransferFileModel::keyToRow(qint64 key) const
 {
-    for (int row = 0; row < m_model->rowCount(); ++row) {
-        if (packetNoString(row) == key) {
-            return row;
-        }
+    QPersistentModelIndex index = m_rows.value(key);
+    if (!index.isValid()) {
+        return -1;
     }
-}
 
-QString TransferFileModel::packetNoString(int row) const
-{
-    return m_model->data(m_model->index(row, TRANSFER_FILE_VIEW_KEY_COLUMN))
-        .toString();
+    return index.row();
 }
 
-void TransferFileModel::removeRow(const QString &key)
+void TransferFileModel::removeRow(qint64 key)
 {
-    QList<int> rowList;
-    for (int row = 0; row < m_model->rowCount(); ++row) {
-        if (packetNoString(row) == key) {
-            rowList << row;
-        }
-    }
-
-    qSort(rowList.begin(), rowList.end(), qGreater<int>());
-    foreach (int row, rowList) {
-        m_model->removeRow(row);
+    QPersistentModelIndex index = m_rows.take(key);
+    if (index.isValid()) {
+        m_model->removeRow(index.row());
     }
 }
-
@@ -18,6 +18,8 @@
 #define TRANSFER_FILE_MODEL_H
 
 #include <QObject>
+#include <QHash>
+#include <QPersistentModelIndex>
 
 class QStandardItemModel;
 class SendFileMap;
@@ -33,17 +35,18 @@ public:
 
     void insertTransfer(SendFileMap*);
 
-    void removeRow(const QString &key);
-    QString packetNoString(int row) const;
+    void removeRow(qint64 key);
 
 public slots:
-    void updateTransfer(QString packetNoString);
+    void updateTransfer(qint64 packetNo);
 
 private:
     void createModel();
-    int keyToRow(QString key) const;
+    int keyToRow(qint64 key) const;
 
     QStandardItemModel *m_model;
+    // Row of each transfer, follows rows when others are removed.
+    QHash<qint64, QPersistentModelIndex> m_rows;
 };
 
 #endif // !TRANSFER_FILE_MODEL_H
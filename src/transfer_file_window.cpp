@@ -127,8 +127,8 @@ void TransferFileWindow::deleteTransfer()
     }
 
     foreach (int row, rowList) {
-        QString packetNo = proxyModel->data(proxyModel->index(row,
-                    TRANSFER_FILE_VIEW_KEY_COLUMN)).toString();
+        qint64 packetNo = proxyModel->data(proxyModel->index(row,
+                    TRANSFER_FILE_VIEW_KEY_COLUMN)).toLongLong();
         if (!Global::sendFileManager
             ->transferFileMap.value(packetNo)->isTransfer()) {
             Global::sendFileManager->removeTransfer(packetNo);
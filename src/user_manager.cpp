@@ -22,17 +22,37 @@
 #include "preferences.h"
 #include "constants.h"
 #include "msg_thread.h"
+#include "presence_cache.h"
 
 #include <QStringList>
 #include <QStandardItemModel>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QTimer>
+#include <QBrush>
+#include <QDateTime>
+
+#include <algorithm>
+#include <climits>
+#include <functional>
 
 Owner UserManager::m_ourself;
 
 UserManager::UserManager(QObject *parent)
-    : QObject(parent)
+    : QObject(parent), m_nextPeerId(1)
 {
     updateOurself();
     createModel();
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(USER_UPDATE_FLUSH_INTERVAL);
+    connect(m_flushTimer, SIGNAL(timeout()), this, SLOT(flushUpdates()));
+
+    m_staleTimer = new QTimer(this);
+    m_staleTimer->setSingleShot(true);
+    m_staleTimer->setInterval(PRESENCE_CACHE_CONFIRM_TIMEOUT);
+    connect(m_staleTimer, SIGNAL(timeout()), this, SLOT(dropStalePeers()));
 }
 
 void UserManager::updateOurself()
@@ -59,7 +79,7 @@ void UserManager::createModel()
     m_model->setHorizontalHeaderLabels(labels);
 }
 
-void UserManager::newUserMsg(Msg msg)
+void UserManager::newUserMsg(const Msg &msg)
 {
     if (!msg->owner().group().isEmpty()
             && !Global::preferences->groupNameList
@@ -67,41 +87,317 @@ void UserManager::newUserMsg(Msg msg)
         Global::preferences->groupNameList.prepend(msg->owner().group());
     }
 
-    if (contains(msg->ip())) {
-        updateUser(msg->owner(), ipToRow(msg->ip()));
+    QWriteLocker locker(&m_peersLock);
+
+    updatePeer(msg->owner(), QDateTime::currentMSecsSinceEpoch());
+
+    scheduleFlush();
+}
+
+// Peers learned from a list server, see MsgServer::processRecvAnsListMsg().
+void UserManager::newUserList(const QList<Owner> &owners)
+{
+    QWriteLocker locker(&m_peersLock);
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    foreach (const Owner &owner, owners) {
+        updatePeer(owner, now);
+    }
+
+    scheduleFlush();
+}
+
+// Called with m_peersLock locked for write.
+void UserManager::updatePeer(const Owner &owner, qint64 now)
+{
+    quint32 key = owner.ipAddress().toIPv4Address();
+
+    QHash<quint32, Peer>::iterator it = m_peers.find(key);
+    if (it != m_peers.end()) {
+        it->owner = owner;
+        it->online = true;
+        it->lastSeen = now;
+        if (it->index.isValid()) {
+            m_changedPeers.insert(key);
+        }
     } else {
-        int row = m_model->rowCount();
-        m_model->insertRow(row);
-        addUser(msg->owner(), row);
+        Peer peer;
+        peer.id = m_nextPeerId++;
+        peer.owner = owner;
+        peer.online = true;
+        peer.lastSeen = now;
+        m_peers.insert(key, peer);
+        m_addedPeers.append(key);
+    }
+}
+
+void UserManager::newExitMsg(const Msg &msg)
+{
+    quint32 key = msg->ipAddress().toIPv4Address();
+
+    QWriteLocker locker(&m_peersLock);
 
-        emit userCountUpdated(m_model->rowCount());
+    QHash<quint32, Peer>::iterator it = m_peers.find(key);
+    if (it == m_peers.end()) {
+        return;
     }
+
+    if (it->index.isValid()) {
+        m_removedRows.append(it->index);
+    }
+    m_addedPeers.removeAll(key);
+    m_changedPeers.remove(key);
+    m_peers.erase(it);
+
+    scheduleFlush();
 }
 
-void UserManager::newExitMsg(Msg msg)
+void UserManager::clearUsers()
 {
-    int row;
-    if ((row = ipToRow(msg->ip())) != -1) {
-        m_model->removeRow(row);
+    QWriteLocker locker(&m_peersLock);
+
+    m_flushTimer->stop();
+    m_addedPeers.clear();
+    m_changedPeers.clear();
+    m_removedRows.clear();
 
-        emit userCountUpdated(m_model->rowCount());
+    m_peers.clear();
+    locker.unlock();
+
+    m_model->removeRows(0, m_model->rowCount());
+}
+
+void UserManager::loadPresenceCache()
+{
+    QList<PresenceCache::Entry> entries
+        = PresenceCache::load(QDateTime::currentMSecsSinceEpoch());
+    if (entries.isEmpty()) {
+        return;
     }
+
+    QWriteLocker locker(&m_peersLock);
+
+    foreach (const PresenceCache::Entry &entry, entries) {
+        quint32 key = entry.owner.ipAddress().toIPv4Address();
+        if (m_peers.contains(key)) {
+            continue;
+        }
+
+        Peer peer;
+        peer.id = m_nextPeerId++;
+        peer.owner = entry.owner;
+        peer.lastSeen = entry.lastSeen;
+        m_peers.insert(key, peer);
+        m_addedPeers.append(key);
+    }
+
+    scheduleFlush();
+    m_staleTimer->start();
+}
+
+void UserManager::savePresenceCache() const
+{
+    QList<PresenceCache::Entry> entries;
+
+    QReadLocker locker(&m_peersLock);
+
+    foreach (const Peer &peer, m_peers) {
+        PresenceCache::Entry entry;
+        entry.owner = peer.owner;
+        entry.lastSeen = peer.lastSeen;
+        entries.append(entry);
+    }
+
+    locker.unlock();
+
+    PresenceCache::save(entries, QDateTime::currentMSecsSinceEpoch());
+}
+
+// Cached peers which did not answer our BR_ENTRY are really offline.
+void UserManager::dropStalePeers()
+{
+    QWriteLocker locker(&m_peersLock);
+
+    QHash<quint32, Peer>::iterator it = m_peers.begin();
+    while (it != m_peers.end()) {
+        if (it->online) {
+            ++it;
+            continue;
+        }
+
+        if (it->index.isValid()) {
+            m_removedRows.append(it->index);
+        }
+        m_addedPeers.removeAll(it.key());
+        m_changedPeers.remove(it.key());
+        it = m_peers.erase(it);
+    }
+
+    scheduleFlush();
 }
 
-void UserManager::updateUser(const Owner &owner, int row)
+void UserManager::scheduleFlush()
 {
-    m_model->setData(m_model->index(row, USER_VIEW_NAME_COLUMN),
-                       owner.name());
-    m_model->setData(m_model->index(row, USER_VIEW_GROUP_COLUMN),
-                       owner.group());
-    m_model->setData(m_model->index(row, USER_VIEW_HOST_COLUMN),
-                       owner.host());
-    m_model->setData(m_model->index(row, USER_VIEW_IP_COLUMN),
-                       owner.ip());
-    m_model->setData(m_model->index(row, USER_VIEW_LOGIN_NAME_COLUMN),
-                       owner.loginName());
-    m_model->setData(m_model->index(row, USER_VIEW_DISPLAY_LEVEL_COLUMN),
-                       owner.displayLevel());
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+// Apply everything queued since the last flush: removals as contiguous
+// ranges, additions as one range insert, and one dataChanged for the
+// filled cells so the sort/filter proxies only redo their work once.
+//
+// Queued changes are taken under m_peersLock, the model is updated after
+// releasing it. Peers are only modified in this thread, so they can not go
+// away meanwhile.
+void UserManager::flushUpdates()
+{
+    QList<QPersistentModelIndex> removedRows;
+    QList<PendingPeer> added;
+    QList<PendingPeer> changed;
+
+    QWriteLocker locker(&m_peersLock);
+
+    removedRows.swap(m_removedRows);
+
+    // Additions, skipping peers that left again before the flush, and keys
+    // queued more than once.
+    QSet<quint32> addedKeys;
+    foreach (quint32 key, m_addedPeers) {
+        QHash<quint32, Peer>::const_iterator it = m_peers.constFind(key);
+        if (it != m_peers.constEnd() && !it->index.isValid()
+            && !addedKeys.contains(key)) {
+            addedKeys.insert(key);
+            added.append(PendingPeer(key, *it));
+        }
+    }
+    m_addedPeers.clear();
+
+    foreach (quint32 key, m_changedPeers) {
+        QHash<quint32, Peer>::const_iterator it = m_peers.constFind(key);
+        if (it != m_peers.constEnd() && it->index.isValid()) {
+            changed.append(PendingPeer(key, *it));
+        }
+    }
+    m_changedPeers.clear();
+
+    locker.unlock();
+
+    // Removals, from the bottom up so the remaining rows stay valid.
+    QList<int> rows;
+    foreach (const QPersistentModelIndex &index, removedRows) {
+        if (index.isValid()) {
+            rows.append(index.row());
+        }
+    }
+
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    int i = 0;
+    while (i < rows.size()) {
+        int last = rows.at(i);
+        int first = last;
+        while (++i < rows.size() && rows.at(i) == first - 1) {
+            first = rows.at(i);
+        }
+        m_model->removeRows(first, last - first + 1);
+    }
+
+    int firstChanged = INT_MAX;
+    int lastChanged = -1;
+
+    if (!added.isEmpty()) {
+        int firstRow = m_model->rowCount();
+        m_model->insertRows(firstRow, added.size());
+
+        m_model->blockSignals(true);
+        for (int j = 0; j < added.size(); ++j) {
+            addUser(added.at(j).owner, firstRow + j);
+            setRowOnline(firstRow + j, added.at(j).online);
+        }
+        m_model->blockSignals(false);
+
+        locker.relock();
+        for (int j = 0; j < added.size(); ++j) {
+            QHash<quint32, Peer>::iterator it = m_peers.find(added.at(j).key);
+            if (it != m_peers.end()) {
+                it->index
+                    = QPersistentModelIndex(m_model->index(firstRow + j, 0));
+            }
+        }
+        locker.unlock();
+
+        firstChanged = firstRow;
+        lastChanged = firstRow + added.size() - 1;
+    }
+
+    // Updates, only writing the cells whose value differs.
+    m_model->blockSignals(true);
+    foreach (const PendingPeer &peer, changed) {
+        if (!peer.index.isValid()) {
+            continue;
+        }
+
+        int row = peer.index.row();
+        bool isChanged = updateUser(peer.owner, row);
+        isChanged |= setRowOnline(row, peer.online);
+        if (isChanged) {
+            firstChanged = qMin(firstChanged, row);
+            lastChanged = qMax(lastChanged, row);
+        }
+    }
+    m_model->blockSignals(false);
+
+    if (lastChanged >= 0) {
+        emit m_model->dataChanged(
+            m_model->index(firstChanged, 0),
+            m_model->index(lastChanged, m_model->columnCount() - 1));
+    }
+
+    emit userCountUpdated(m_model->rowCount());
+}
+
+bool UserManager::setDataIfChanged(int row, int column, const QString &value)
+{
+    QModelIndex index = m_model->index(row, column);
+    if (m_model->data(index).toString() == value) {
+        return false;
+    }
+
+    return m_model->setData(index, value);
+}
+
+// Possibly online peers are shown grayed out.
+bool UserManager::setRowOnline(int row, bool online)
+{
+    bool changed = false;
+    QVariant brush = online ? QVariant() : QVariant(QBrush(Qt::gray));
+
+    for (int column = 0; column < m_model->columnCount(); ++column) {
+        QModelIndex index = m_model->index(row, column);
+        if (m_model->data(index, Qt::ForegroundRole).isValid() != !online) {
+            m_model->setData(index, brush, Qt::ForegroundRole);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Returns whether any cell changed.
+bool UserManager::updateUser(const Owner &owner, int row)
+{
+    bool changed = false;
+
+    changed |= setDataIfChanged(row, USER_VIEW_NAME_COLUMN, owner.name());
+    changed |= setDataIfChanged(row, USER_VIEW_GROUP_COLUMN, owner.group());
+    changed |= setDataIfChanged(row, USER_VIEW_HOST_COLUMN, owner.host());
+    changed |= setDataIfChanged(row, USER_VIEW_IP_COLUMN, owner.ip());
+    changed |= setDataIfChanged(row, USER_VIEW_LOGIN_NAME_COLUMN,
+                                owner.loginName());
+    changed |= setDataIfChanged(row, USER_VIEW_DISPLAY_LEVEL_COLUMN,
+                                owner.displayLevel());
+
+    return changed;
 }
 
 void UserManager::addUser(const Owner &owner, int row)
@@ -141,22 +437,65 @@ void UserManager::broadcastEntry() const
 
     quint32 flags = 0;
     flags |= IPMSG_BR_ENTRY | QIPMSG_CAPACITY;
+    if (Global::preferences->isMulticastDiscovery) {
+        flags |= IPMSG_MULTICASTOPT;
+    }
 
     SendMsg sendMsg(QHostAddress::Null, 0/* port */,
                     entryMessage(), ""/* extendedInfo */, flags);
 
     Global::msgThread->addSendMsg(Msg(sendMsg));
+
+    // Ask a list server for peers our broadcast does not reach.
+    if (!Global::preferences->isListServer) {
+        SendMsg getList(QHostAddress::Null, 0/* port */,
+                        ""/* additionalInfo */, ""/* extendedInfo */,
+                        IPMSG_BR_ISGETLIST2);
+        Global::msgThread->addSendMsg(Msg(getList));
+    }
 }
 
 bool UserManager::contains(QString ip) const
 {
-    for (int row = 0; row < m_model->rowCount(); ++row) {
-        if (this->ip(row) == ip) {
-            return true;
+    return contains(QHostAddress(ip));
+}
+
+bool UserManager::contains(const QHostAddress &address) const
+{
+    QReadLocker locker(&m_peersLock);
+
+    QHash<quint32, Peer>::const_iterator it
+        = m_peers.constFind(address.toIPv4Address());
+    return it != m_peers.constEnd() && it->online;
+}
+
+QList<Owner> UserManager::onlinePeers() const
+{
+    QList<Owner> owners;
+
+    QReadLocker locker(&m_peersLock);
+
+    foreach (const Peer &peer, m_peers) {
+        if (peer.online) {
+            owners << peer.owner;
         }
     }
 
-    return false;
+    return owners;
+}
+
+int UserManager::peerCount() const
+{
+    QReadLocker locker(&m_peersLock);
+
+    return m_peers.size();
+}
+
+quint32 UserManager::peerId(const QHostAddress &address) const
+{
+    QReadLocker locker(&m_peersLock);
+
+    return m_peers.value(address.toIPv4Address()).id;
 }
 
 void UserManager::display() const
@@ -174,13 +513,15 @@ QString UserManager::ip(int row) const
 
 int UserManager::ipToRow(QString ip) const
 {
-    for (int row = 0; row < m_model->rowCount(); ++row) {
-        if (this->ip(row) == ip) {
-            return row;
-        }
+    QReadLocker locker(&m_peersLock);
+
+    QHash<quint32, Peer>::const_iterator it
+        = m_peers.find(QHostAddress(ip).toIPv4Address());
+    if (it == m_peers.end() || !it->index.isValid()) {
+        return -1;
     }
 
-    return -1;
+    return it->index.row();
 }
 
 QString UserManager::name(int row) const
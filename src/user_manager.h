@@ -21,8 +21,15 @@
 #include "msg.h"
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QPersistentModelIndex>
+#include <QReadWriteLock>
+#include <QHostAddress>
 
 class QStandardItemModel;
+class QTimer;
 
 class UserManager : public QObject
 {
@@ -38,11 +45,30 @@ public:
     void broadcastExit() const;
     void broadcastEntry() const;
 
+    // Whether the peer is known online, may be called in any thread.
     bool contains(QString ip) const;
+    bool contains(const QHostAddress &address) const;
 
     QString ip(int row) const;
     int ipToRow(QString ip) const;
 
+    // Snapshot of peers known online, may be called in any thread.
+    QList<Owner> onlinePeers() const;
+
+    // Number of known peers, may be called in any thread.
+    int peerCount() const;
+
+    // Stable id of a peer while it is online, 0 if it is unknown.
+    quint32 peerId(const QHostAddress &address) const;
+
+    // Forget all peers, e.g. before refresh.
+    void clearUsers();
+
+    // Show peers of the last run as possibly online until they answer,
+    // call before broadcastEntry().
+    void loadPresenceCache();
+    void savePresenceCache() const;
+
     QString name(int row) const;
     QString group(int row) const;
     QString host(int row) const;
@@ -60,16 +86,60 @@ signals:
     void userCountUpdated(int userCount);
 
 private slots:
-    void newUserMsg(Msg msg);
-    void newExitMsg(Msg msg);
+    void newUserMsg(const Msg &msg);
+    void newExitMsg(const Msg &msg);
+    void newUserList(const QList<Owner> &owners);
+    void flushUpdates();
+    void dropStalePeers();
 
 private:
     void createModel();
-    void updateUser(const Owner &owner, int row);
+    void updatePeer(const Owner &owner, qint64 now);
+    bool updateUser(const Owner &owner, int row);
     void addUser(const Owner &owner, int row);
+    bool setDataIfChanged(int row, int column, const QString &value);
+    bool setRowOnline(int row, bool online);
+    void scheduleFlush();
 
     static Owner m_ourself;
 
+    // Peer table is the source of truth, m_model is only a view of it.
+    struct Peer {
+        Peer() : id(0), online(false), lastSeen(0) {}
+
+        quint32 id;
+        Owner owner;
+        QPersistentModelIndex index;
+        bool online;        // false while only known from presence cache
+        qint64 lastSeen;
+    };
+
+    // Copy of a peer taken by flushUpdates() to update m_model unlocked.
+    struct PendingPeer {
+        PendingPeer(quint32 k, const Peer &peer)
+            : key(k), owner(peer.owner), index(peer.index),
+            online(peer.online) {}
+
+        quint32 key;
+        Owner owner;
+        QPersistentModelIndex index;
+        bool online;
+    };
+
+    // Guards the peer table, which the msg thread reads. Peers are only
+    // modified in GUI thread, and m_model is updated without this lock, so
+    // that model signals never hold up the msg thread.
+    mutable QReadWriteLock m_peersLock;
+    QHash<quint32, Peer> m_peers;   // key is IPv4 address
+    quint32 m_nextPeerId;
+
+    // Model changes queued until the next flush, see flushUpdates().
+    QList<quint32> m_addedPeers;     // may repeat, deduped by flush
+    QSet<quint32> m_changedPeers;
+    QList<QPersistentModelIndex> m_removedRows;
+    QTimer *m_flushTimer;
+    QTimer *m_staleTimer;
+
     QStandardItemModel *m_model;
 };
 
@@ -28,10 +28,24 @@
 
 #include <QPoint>
 #include <QSize>
+#include <QMessageBox>
+#include <QCoreApplication>
 
 WindowManager::WindowManager(QObject *parent)
     : QObject(parent)
 {
+    connect(Global::msgThread, SIGNAL(newMsg(Msg)),
+            this, SLOT(newMsg(Msg)));
+    connect(Global::msgThread, SIGNAL(sendMsgLost(Msg)),
+            this, SLOT(sendMsgLost(Msg)));
+    connect(Global::msgThread, SIGNAL(error(QString)),
+            this, SLOT(msgThreadError(QString)));
+    connect(Global::msgThread, SIGNAL(fatalError(QString)),
+            this, SLOT(msgThreadFatalError(QString)));
+
+    m_lostMsgTimer.setSingleShot(true);
+    m_lostMsgTimer.setInterval(SEND_MSG_LOST_NOTICE_DELAY);
+    connect(&m_lostMsgTimer, SIGNAL(timeout()), this, SLOT(showLostMsgs()));
 }
 
 WindowManager::~WindowManager()
@@ -40,7 +54,7 @@ WindowManager::~WindowManager()
     destroyMsgReadedWindowList();
 }
 
-void WindowManager::newMsg(Msg msg)
+void WindowManager::newMsg(const Msg &msg)
 {
     switch (GET_MODE(msg->flags())) {
     case IPMSG_SENDMSG:
@@ -55,7 +69,47 @@ void WindowManager::newMsg(Msg msg)
     }
 }
 
-void WindowManager::createMsgWindow(Msg msg)
+void WindowManager::sendMsgLost(const Msg &msg)
+{
+    if (!m_lostMsgIps.contains(msg->ip())) {
+        m_lostMsgIps << msg->ip();
+    }
+    m_lostMsgText = msg->additionalInfo().section(QChar('\0'), 0, 0);
+
+    if (!m_lostMsgTimer.isActive()) {
+        m_lostMsgTimer.start();
+    }
+}
+
+void WindowManager::showLostMsgs()
+{
+    QString text = m_lostMsgText;
+    if (text.size() > 64) {
+        text = text.left(64) + "...";
+    }
+
+    Global::systray->showWarning(tr("QIpMsg"),
+                                 tr("Message to %1 was not confirmed:\n%2")
+                                 .arg(m_lostMsgIps.join(", ")).arg(text));
+
+    m_lostMsgIps.clear();
+    m_lostMsgText.clear();
+}
+
+void WindowManager::msgThreadError(QString errorString)
+{
+    QMessageBox::critical(0, tr("QIpMsg"), errorString);
+}
+
+void WindowManager::msgThreadFatalError(QString errorString)
+{
+    QMessageBox::critical(0, tr("QIpMsg"), errorString);
+
+    // main() sees MsgThread::hasFatalError() and exits with error.
+    QCoreApplication::quit();
+}
+
+void WindowManager::createMsgWindow(const Msg &msg)
 {
     //MsgWindow *msgWindow = new MsgWindow(msg);
 
@@ -80,7 +134,7 @@ void WindowManager::createMsgWindow(Msg msg)
     }
 }
 
-void WindowManager::createMsgReadedWindow(Msg msg)
+void WindowManager::createMsgReadedWindow(const Msg &msg)
 {
     ChatWindow* pcw = NULL;
     QString ip = msg->ip();
@@ -22,6 +22,8 @@
 #include <QMap>
 #include <QMapIterator>
 #include <QMutex>
+#include <QStringList>
+#include <QTimer>
 
 #include "owner.h"
 #include "msg.h"
@@ -70,18 +72,28 @@ public:
     int hidedMsgWindowCount() const;
 
 private slots:
-    void newMsg(Msg msg);
+    void newMsg(const Msg &msg);
+    void sendMsgLost(const Msg &msg);
+    void msgThreadError(QString errorString);
+    void msgThreadFatalError(QString errorString);
+    void showLostMsgs();
     void destroyMsgReadedWindowList();
 
 private:
-    void createMsgWindow(Msg msg);
-    void createMsgReadedWindow(Msg msg);
+    void createMsgWindow(const Msg &msg);
+    void createMsgReadedWindow(const Msg &msg);
 
     void destroyMsgWindowList();
 
     QList<MsgWindow *> m_msgWindowList;
     QList<MsgReadedWindow *> m_msgReadedWindowList;
     QMap<QString, ChatWindow *> m_msgChatWindowList; //chat dialog
+
+    // Lost msgs are collected for a while and reported in one notice, one
+    // send to many offline users loses them all at about the same time.
+    QStringList m_lostMsgIps;
+    QString m_lostMsgText;
+    QTimer m_lostMsgTimer;
 };
 
 #endif // !WINDOW_MANAGER_H
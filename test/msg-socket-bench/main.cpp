@@ -0,0 +1,166 @@
+// Datagrams per second over loopback through MsgSocket, which batches
+// with sendmmsg()/recvmmsg() on Linux, against the QUdpSocket one call per
+// datagram path it replaced.
+//
+// Bursts start at MIN_BURST_SIZE datagrams and double up to MAX_BURST_SIZE.
+// For every burst size each backend prints the datagrams received per
+// second and the drops (sent minus received), and at the end the first
+// burst size at which it dropped, i.e. where the receiver fell behind.
+//
+// Usage: msg-socket-bench [rounds] [port]
+// Ports port .. port+3 on localhost are used.
+
+#include "msg_socket.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QUdpSocket>
+#include <QVector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MIN_BURST_SIZE  64
+#define MAX_BURST_SIZE  16384
+#define PACKET_SIZE     128
+#define RECV_BUFFER_SIZE (1024*1024)
+
+struct Result
+{
+    Result() : sent(0), received(0), ns(0) {}
+
+    int sent;
+    int received;
+    qint64 ns;
+};
+
+static void report(const char *name, int burstSize, const Result &result)
+{
+    double seconds = result.ns / 1e9;
+    printf("%-12s burst %6d  sent %9d recv %9d drop %9d  %10.0f recv/s\n",
+           name, burstSize, result.sent, result.received,
+           result.sent - result.received,
+           seconds > 0 ? result.received / seconds : 0.0);
+}
+
+static void reportThreshold(const char *name, int burstSize)
+{
+    if (burstSize > 0) {
+        printf("%-12s drops from burst %d\n", name, burstSize);
+    } else {
+        printf("%-12s no drops up to burst %d\n", name, MAX_BURST_SIZE);
+    }
+}
+
+static bool benchMsgSocket(int rounds, int burstSize, quint16 port,
+                           Result *result)
+{
+    MsgSocket sender;
+    MsgSocket receiver;
+    if (!sender.bind(port) || !receiver.bind(port + 1)) {
+        fprintf(stderr, "MsgSocket bind: %s\n",
+                receiver.errorString().toLocal8Bit().constData());
+        return false;
+    }
+
+    QByteArray data(PACKET_SIZE, 'x');
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVector<bool> results;
+    QList<MsgSocket::Datagram> datagrams;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < burstSize; ++i) {
+            sender.queueDatagram(data, localhost, port + 1);
+        }
+        sender.flush(results);
+        result->sent += results.count(true);
+
+        while (receiver.readDatagrams(datagrams) > 0) {
+            result->received += datagrams.size();
+            datagrams.clear();
+        }
+    }
+    result->ns = timer.nsecsElapsed();
+
+    return true;
+}
+
+static bool benchQUdpSocket(int rounds, int burstSize, quint16 port,
+                            Result *result)
+{
+    QUdpSocket sender;
+    QUdpSocket receiver;
+    if (!sender.bind(QHostAddress::LocalHost, port)
+        || !receiver.bind(QHostAddress::LocalHost, port + 1)) {
+        fprintf(stderr, "QUdpSocket bind: %s\n",
+                receiver.errorString().toLocal8Bit().constData());
+        return false;
+    }
+    receiver.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption,
+                             RECV_BUFFER_SIZE);
+
+    QByteArray data(PACKET_SIZE, 'x');
+    QByteArray buffer(65536, 0);
+    QHostAddress localhost(QHostAddress::LocalHost);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < burstSize; ++i) {
+            if (sender.writeDatagram(data, localhost, port + 1) != -1) {
+                ++result->sent;
+            }
+        }
+
+        while (receiver.hasPendingDatagrams()) {
+            if (receiver.readDatagram(buffer.data(), buffer.size()) != -1) {
+                ++result->received;
+            }
+        }
+    }
+    result->ns = timer.nsecsElapsed();
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int rounds = argc > 1 ? atoi(argv[1]) : 200;
+    quint16 port = argc > 2 ? atoi(argv[2]) : 24250;
+
+    printf("%d rounds per burst of %d byte datagrams\n", rounds,
+           PACKET_SIZE);
+
+    // first burst size that dropped, 0 if none did
+    int udpThreshold = 0;
+    int msgThreshold = 0;
+    for (int burstSize = MIN_BURST_SIZE; burstSize <= MAX_BURST_SIZE;
+         burstSize *= 2) {
+        Result udp;
+        if (!benchQUdpSocket(rounds, burstSize, port + 2, &udp)) {
+            return 1;
+        }
+        report("QUdpSocket", burstSize, udp);
+        if (udpThreshold == 0 && udp.received < udp.sent) {
+            udpThreshold = burstSize;
+        }
+
+        Result msg;
+        if (!benchMsgSocket(rounds, burstSize, port, &msg)) {
+            return 1;
+        }
+        report("MsgSocket", burstSize, msg);
+        if (msgThreshold == 0 && msg.received < msg.sent) {
+            msgThreshold = burstSize;
+        }
+    }
+
+    reportThreshold("QUdpSocket", udpThreshold);
+    reportThreshold("MsgSocket", msgThreshold);
+
+    return 0;
+}
@@ -0,0 +1,21 @@
+TEMPLATE = app
+
+TARGET = msg-socket-bench
+
+CONFIG += qt warn_on release console
+
+QT = core network
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+    ../../src/msg_socket.h
+
+SOURCES += \
+    main.cpp \
+    ../../src/msg_socket.cpp
+
+unix {
+  MOC_DIR = .moc
+  OBJECTS_DIR = .obj
+}
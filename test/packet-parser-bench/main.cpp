@@ -0,0 +1,145 @@
+// Compare PacketParser with the QString::split parser it replaced: check
+// both give the same fields on sample packets, then time them.
+//
+// Usage: packet-parser-bench [rounds]
+
+#include "packet_parser.h"
+#include "constants.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+#include <QTextCodec>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Fields
+{
+    QString version;
+    QString packetNo;
+    QString loginName;
+    QString host;
+    quint32 flags;
+    QString additionalInfo;
+    QString extendedInfo;
+};
+
+// What MsgBase::parsePacket() and Owner::initOwner() did before.
+static bool oldParse(const QByteArray &datagram, QTextCodec *codec,
+                     Fields &f)
+{
+    QString packet = codec->toUnicode(datagram);
+    QStringList list = packet.split(COMMAND_SEPERATOR);
+    if (list.count() < MSG_NORMAL_FIELD_COUNT) {
+        return false;
+    }
+
+    f.version = list.at(MSG_VERSION_POS);
+    f.packetNo = list.at(MSG_PACKET_NO_POS);
+    f.loginName = list.at(MSG_LOG_NAME_POS);
+    f.host = list.at(MSG_HOST_POS);
+    f.flags = list.at(MSG_FLAGS_POS).toUInt();
+
+    int index = 0;
+    for (int cnt = 0; cnt < MSG_ADDITION_INFO_POS; ++cnt) {
+        index = packet.indexOf(QChar(COMMAND_SEPERATOR), index) + 1;
+    }
+    QString s = packet.right(packet.size() - index);
+    f.additionalInfo = s.section(QChar(EXTEND_INFO_SEPERATOR), 0, 0);
+    f.extendedInfo = s.section(QChar(EXTEND_INFO_SEPERATOR), 1, 1);
+
+    return true;
+}
+
+static bool newParse(const QByteArray &datagram, QTextCodec *codec,
+                     Fields &f)
+{
+    PacketParser parser;
+    if (!parser.parse(datagram.constData(), datagram.size())) {
+        return false;
+    }
+
+    f.version = parser.toString(PacketParser::Version, codec);
+    f.packetNo = parser.toString(PacketParser::PacketNo, codec);
+    f.loginName = parser.toString(PacketParser::LoginName, codec);
+    f.host = parser.toString(PacketParser::Host, codec);
+    f.flags = parser.flags();
+    f.additionalInfo = parser.toString(PacketParser::AdditionalInfo, codec);
+    f.extendedInfo = parser.toString(PacketParser::ExtendedInfo, codec);
+
+    return true;
+}
+
+static QList<QByteArray> samplePackets()
+{
+    QList<QByteArray> packets;
+
+    packets << QByteArray("1:100:alice:host-a:1:Alice\0Group A\0", 34);
+    packets << QByteArray("1:1234567890:bob:host-b:288:hello, world\0", 41);
+    // ':' inside additionalInfo belongs to it.
+    packets << QByteArray("1:7:carol:host-c:2097440:0:a::b.txt:1a:5f00:1:\a",
+                          47);
+    packets << QByteArray("1:42:dave:host-d:3:", 19);
+    packets << "1_lbt4_0#128#000C29D0A5E3#0#0#0:1300000000:eve:host-e:"
+               "6291457:\xe4\xbd\xa0\xe5\xa5\xbd";
+
+    QByteArray big("1:99:frank:host-f:32:");
+    big.append(QByteArray(1200, 'x'));
+    big.append('\0');
+    big.append("extended");
+    packets << big;
+
+    return packets;
+}
+
+static bool equal(const Fields &a, const Fields &b)
+{
+    return a.version == b.version && a.packetNo == b.packetNo
+        && a.loginName == b.loginName && a.host == b.host
+        && a.flags == b.flags && a.additionalInfo == b.additionalInfo
+        && a.extendedInfo == b.extendedInfo;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+    QTextCodec *codec = QTextCodec::codecForName("UTF-8");
+    QList<QByteArray> packets = samplePackets();
+
+    int failed = 0;
+    foreach (const QByteArray &packet, packets) {
+        Fields a, b;
+        bool okA = oldParse(packet, codec, a);
+        bool okB = newParse(packet, codec, b);
+        if (okA != okB || (okA && !equal(a, b))) {
+            fprintf(stderr, "mismatch: %s\n", packet.constData());
+            ++failed;
+        }
+    }
+    if (failed) {
+        return 1;
+    }
+
+    Fields f;
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int i = 0; i < rounds; ++i) {
+        oldParse(packets.at(i % packets.size()), codec, f);
+    }
+    qint64 oldNs = timer.nsecsElapsed();
+
+    timer.start();
+    for (int i = 0; i < rounds; ++i) {
+        newParse(packets.at(i % packets.size()), codec, f);
+    }
+    qint64 newNs = timer.nsecsElapsed();
+
+    printf("%d packets, %d rounds\n", packets.size(), rounds);
+    printf("split parser:  %8.1f ns/packet\n", double(oldNs) / rounds);
+    printf("PacketParser:  %8.1f ns/packet\n", double(newNs) / rounds);
+
+    return 0;
+}
@@ -0,0 +1,21 @@
+TEMPLATE = app
+
+TARGET = packet-parser-bench
+
+CONFIG += qt warn_on release console
+
+QT = core
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+    ../../src/packet_parser.h
+
+SOURCES += \
+    main.cpp \
+    ../../src/packet_parser.cpp
+
+unix {
+  MOC_DIR = .moc
+  OBJECTS_DIR = .obj
+}